@@ -0,0 +1,257 @@
+// Allocator benchmarks, run with: .build/allocators
+#include <cstdio>
+#include <chrono>
+
+#include "Basic/module.hpp"
+#include "Tracking_Allocator.hpp"
+#include "Threads/module.hpp"
+
+auto get_seconds() -> f64 {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// "cycles" rounds of "count" small allocations (16..256 bytes, each touched) followed by freeing all of them.
+// Allocators that can't free individually get reset at the end of the cycle instead.
+template<typename Reset>
+auto bench_cycles(Allocator allocator, s64 cycles, s64 count, bool free_each, Reset reset) -> f64 {
+    Array_View<void*> pointers;
+    auto malloc_allocator = Allocator{&default_allocator_proc, nullptr};
+    push_allocator(malloc_allocator, pointers = NewArray<void*>(count);)
+
+    u64 x = 12345;
+
+    auto start = get_seconds();
+
+    for (s64 cycle = 0; cycle < cycles; ++cycle) {
+        push_allocator(allocator,
+            for (s64 i = 0; i < count; ++i) {
+                x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+                auto size = 16 + (s64)((x >> 33) % 241);
+
+                auto memory = (u8*) alloc(size);
+                memory[0]   = (u8) i;
+                pointers[i] = memory;
+            }
+
+            if (free_each) {
+                for (auto p : pointers) dealloc(p);
+            }
+        )
+
+        reset();
+    }
+
+    auto elapsed = get_seconds() - start;
+
+    push_allocator(malloc_allocator, dealloc(pointers.data);)
+
+    return elapsed * 1e9 / (f64)(cycles * count);
+}
+
+struct List_Node {
+    void*      data = {};
+    List_Node* next = {};
+};
+
+// "cycles" rounds of building a "count" node linked list and tearing it down again, node by node
+// or (when "free_each" is off) by resetting the allocator. Returns ns per node.
+template<typename Reset>
+auto bench_lists(Allocator allocator, s64 cycles, s64 count, bool free_each, Reset reset) -> f64 {
+    auto start = get_seconds();
+
+    for (s64 cycle = 0; cycle < cycles; ++cycle) {
+        push_allocator(allocator,
+            List_Node* first = {};
+            for (s64 i = 0; i < count; ++i) {
+                auto node  = New<List_Node>();
+                node->data = (void*) i;
+                node->next = first;
+                first      = node;
+            }
+
+            if (free_each) {
+                while (first) {
+                    auto next = first->next;
+                    dealloc(first);
+                    first = next;
+                }
+            }
+        )
+
+        reset();
+    }
+
+    return (get_seconds() - start) * 1e9 / (f64)(cycles * count);
+}
+
+// Per thread churn: a window of live allocations (16..512 bytes) where every step frees a random one and
+// allocates a replacement. With "handoff" the threads run in producer/consumer pairs instead, the consumer
+// frees what the producer allocated (remote frees for the heap allocator).
+CONST_VAR s64 CHURN_WINDOW = 1024;
+
+struct Churn_Data {
+    Allocator         allocator  = {};
+    s64               operations = {};
+    SPSC_Channel<u8*> channel    = {};
+};
+
+auto churn_proc(Thread* thread) -> s64 {
+    auto& d = *(Churn_Data*) thread->data;
+
+    u8* window[CHURN_WINDOW] = {};
+    u64 x = (u64)(size_t) &x;
+
+    push_allocator(d.allocator,
+        for (s64 i = 0; i < d.operations; ++i) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            auto slot = (x >> 33) % CHURN_WINDOW;
+            auto size = 16 + (s64)((x >> 45) % 497);
+
+            dealloc(window[slot]);
+            window[slot]    = (u8*) alloc(size);
+            window[slot][0] = (u8) i;
+        }
+        for (auto p : window) dealloc(p);
+    )
+
+    return 0;
+}
+
+auto producer_proc(Thread* thread) -> s64 {
+    auto& d = *(Churn_Data*) thread->data;
+
+    u64 x = (u64)(size_t) &x;
+
+    push_allocator(d.allocator,
+        for (s64 i = 0; i < d.operations; ++i) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            auto memory = (u8*) alloc(16 + (s64)((x >> 45) % 497));
+            memory[0]   = (u8) i;
+            send(&d.channel, memory);
+        }
+    )
+
+    return 0;
+}
+
+auto consumer_proc(Thread* thread) -> s64 {
+    auto& d = *(Churn_Data*) thread->data;
+
+    push_allocator(d.allocator,
+        for (s64 i = 0; i < d.operations; ++i) {
+            u8* memory = {};
+            receive(&d.channel, &memory);
+            dealloc(memory);
+        }
+    )
+
+    return 0;
+}
+
+// Returns million allocations per second over all threads:
+auto bench_threads(Allocator allocator, s64 num_threads, s64 operations, bool handoff) -> f64 {
+    auto datas   = NewArray<Churn_Data>(handoff ? num_threads / 2 : num_threads);
+    auto threads = NewArray<Thread>(num_threads);
+
+    for (s64 i = 0; i < num_threads; ++i) {
+        auto& d = handoff ? datas[i / 2] : datas[i];
+        if (!d.allocator.proc) {
+            d.allocator  = allocator;
+            d.operations = operations;
+            if (handoff) init(&d.channel, 256);
+        }
+
+        thread_init(&threads[i], !handoff ? churn_proc : (i % 2 == 0 ? producer_proc : consumer_proc));
+        threads[i].data = &d;
+    }
+
+    auto start = get_seconds();
+
+    for (auto& t : threads) thread_start(&t);
+    for (auto& t : threads) thread_is_done(&t, -1);
+
+    auto elapsed = get_seconds() - start;
+
+    for (auto& t : threads) thread_deinit(&t);
+    if (handoff) for (auto& d : datas) deinit(&d.channel);
+    dealloc(threads.data);
+    dealloc(datas.data);
+
+    auto allocations = handoff ? num_threads / 2 * operations : num_threads * operations;
+    return (f64) allocations / elapsed / 1e6;
+}
+
+int main() {
+    CONST_VAR s64 CYCLES = 200;
+    CONST_VAR s64 COUNT  = 100000;
+
+    printf("small allocations, %ld per cycle (ns per allocation)\n", COUNT);
+
+    auto malloc_ns = bench_cycles(Allocator{&default_allocator_proc, nullptr}, CYCLES, COUNT, true,  []() {});
+    auto temp_ns   = bench_cycles(Allocator{&temp_allocator_proc,    nullptr}, CYCLES, COUNT, false, []() { reset_temp_allocator(); });
+
+    Virtual_Arena arena;
+    init(&arena);
+    auto arena_ns  = bench_cycles(virtual_arena_allocator(&arena), CYCLES, COUNT, false, [&]() { reset(&arena); });
+    auto committed = arena.commit_limit - arena.base;
+    deinit(&arena);
+
+    printf("%16s %16s %16s\n", "malloc/free", "temp allocator", "virtual arena");
+    printf("%16.2f %16.2f %16.2f\n", malloc_ns, temp_ns, arena_ns);
+    printf("virtual arena committed %ld KB of its %lld GB reservation\n", (s64) committed / 1024, DEFAULT_VIRTUAL_ARENA_RESERVE >> 30);
+
+    // What wrapping malloc in a Tracking_Allocator costs:
+    Tracking_Allocator tracker;
+    init(&tracker, false, Allocator{&default_allocator_proc, nullptr});
+    auto tracked_ns = bench_cycles(tracking_allocator(&tracker), CYCLES, COUNT, true, []() {});
+
+    Tracking_Allocator site_tracker;
+    init(&site_tracker, true, Allocator{&default_allocator_proc, nullptr});
+    auto sites_ns = 0.0;
+    {
+        allocation_site("bench_cycles");
+        sites_ns = bench_cycles(tracking_allocator(&site_tracker), CYCLES, COUNT, true, []() {});
+    }
+
+    printf("\n%16s %16s %16s\n", "malloc/free", "tracked", "tracked + sites");
+    printf("%16.2f %16.2f %16.2f\n", malloc_ns, tracked_ns, sites_ns);
+    printf("tracked peak %ld bytes, %ld live at the end\n", tracker.peak_bytes.load(), tracker.live_bytes.load());
+    deinit(&tracker);
+    deinit(&site_tracker);
+
+    printf("\nlinked lists of %ld nodes, built and freed (ns per node)\n", COUNT);
+
+    Pool_Allocator pool;
+    init(&pool, sizeof(List_Node), 1024);
+
+    auto list_malloc_ns = bench_lists(Allocator{&default_allocator_proc, nullptr}, CYCLES, COUNT, true,  []() {});
+    auto list_pool_ns   = bench_lists(pool_allocator(&pool),                       CYCLES, COUNT, true,  []() {});
+    auto list_bulk_ns   = bench_lists(pool_allocator(&pool),                       CYCLES, COUNT, false, [&]() { release_all(&pool); });
+    auto slab_count     = pool.slab_count;
+    deinit(&pool);
+
+    printf("%16s %16s %16s\n", "malloc/free", "pool/free", "pool/release_all");
+    printf("%16.2f %16.2f %16.2f\n", list_malloc_ns, list_pool_ns, list_bulk_ns);
+    printf("pool used %ld slabs of 1024 nodes\n", slab_count);
+
+    CONST_VAR s64 OPERATIONS = 2000000;
+
+    auto glibc = Allocator{&default_allocator_proc, nullptr};
+    auto heap  = Allocator{&heap_allocator_proc,    nullptr};
+
+    printf("\nchurn, %ld random frees + allocs (16..512 bytes) per thread (million allocs/sec)\n", OPERATIONS);
+    printf("%8s %16s %16s\n", "threads", "glibc malloc", "Heap_Allocator");
+    for (s64 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        auto glibc_rate = bench_threads(glibc, num_threads, OPERATIONS, false);
+        auto heap_rate  = bench_threads(heap,  num_threads, OPERATIONS, false);
+        printf("%8ld %16.2f %16.2f\n", num_threads, glibc_rate, heap_rate);
+    }
+
+    printf("\nproducer allocs, consumer frees, %ld per pair (million allocs/sec)\n", OPERATIONS);
+    printf("%8s %16s %16s\n", "threads", "glibc malloc", "Heap_Allocator");
+    for (s64 num_threads = 2; num_threads <= 8; num_threads *= 2) {
+        auto glibc_rate = bench_threads(glibc, num_threads, OPERATIONS, true);
+        auto heap_rate  = bench_threads(heap,  num_threads, OPERATIONS, true);
+        printf("%8ld %16.2f %16.2f\n", num_threads, glibc_rate, heap_rate);
+    }
+}
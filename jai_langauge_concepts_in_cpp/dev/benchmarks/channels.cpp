@@ -0,0 +1,160 @@
+// Channel benchmarks, run with: .build/channels
+// Items handed from producer threads to consumer threads, a heap node + mutex + semaphore per item
+// (like the old Work_List) vs. SPSC_Channel and MPMC_Channel.
+#include <cstdio>
+#include <chrono>
+
+#include "Basic/module.hpp"
+#include "Threads/module.hpp"
+
+auto get_seconds() -> f64 {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CONST_VAR s64 CHANNEL_CAPACITY = 1024;
+
+// Baseline: intrusive list, one node per message, a lock per hop:
+struct Locked_List {
+    Mutex       mutex     = {};
+    Semaphore   semaphore = {};
+    Work_Entry* first     = {};
+    Work_Entry* last      = {};
+};
+
+void locked_send(Locked_List* list, s64 item) {
+    auto& l = *list;
+
+    auto entry  = New<Work_Entry>();
+    entry->work = (void*) item;
+    {
+        lock(&l.mutex);
+        defer { unlock(&l.mutex); };
+
+        if (l.last) l.last->next = entry;
+        else        l.first      = entry;
+        l.last = entry;
+    }
+    signal(&l.semaphore);
+}
+
+auto locked_receive(Locked_List* list) -> s64 {
+    auto& l = *list;
+
+    wait_for(&l.semaphore);
+
+    Work_Entry* entry = {};
+    {
+        lock(&l.mutex);
+        defer { unlock(&l.mutex); };
+
+        entry   = l.first;
+        l.first = entry->next;
+        if (!l.first) l.last = nullptr;
+    }
+
+    auto result = (s64) entry->work;
+    dealloc(entry);
+    return result;
+}
+
+enum class Channel_Kind {
+    LOCKED_LIST,
+    SPSC,
+    MPMC
+};
+
+struct Bench_Data {
+    Channel_Kind         kind           = {};
+    Locked_List          list           = {};
+    SPSC_Channel<s64>    spsc           = {};
+    MPMC_Channel<s64>    mpmc           = {};
+    s64                  items_per_side = {};
+    std::atomic<s64>     sum            = {};
+};
+
+auto producer_proc(Thread* thread) -> s64 {
+    auto& d = *(Bench_Data*) thread->data;
+
+    for (s64 i = 1; i <= d.items_per_side; ++i) {
+        switch (d.kind) {
+            case Channel_Kind::LOCKED_LIST: locked_send(&d.list, i); break;
+            case Channel_Kind::SPSC:        send(&d.spsc, i);        break;
+            case Channel_Kind::MPMC:        send(&d.mpmc, i);        break;
+        }
+    }
+
+    return 0;
+}
+
+auto consumer_proc(Thread* thread) -> s64 {
+    auto& d = *(Bench_Data*) thread->data;
+
+    s64 sum = {};
+    for (s64 i = 0; i < d.items_per_side; ++i) {
+        s64 item = {};
+        switch (d.kind) {
+            case Channel_Kind::LOCKED_LIST: item = locked_receive(&d.list); break;
+            case Channel_Kind::SPSC:        receive(&d.spsc, &item);         break;
+            case Channel_Kind::MPMC:        receive(&d.mpmc, &item);         break;
+        }
+        sum += item;
+    }
+
+    d.sum.fetch_add(sum, std::memory_order_relaxed);
+    return 0;
+}
+
+// "pairs" producers and "pairs" consumers, every producer sends "items_per_side" items. Returns items/sec.
+auto bench_channel(Channel_Kind kind, s64 pairs, s64 items_per_side) -> f64 {
+    Bench_Data d;
+    d.kind           = kind;
+    d.items_per_side = items_per_side;
+
+    init(&d.list.mutex);
+    init(&d.list.semaphore);
+    init(&d.spsc, CHANNEL_CAPACITY);
+    init(&d.mpmc, CHANNEL_CAPACITY);
+
+    auto threads = NewArray<Thread>(pairs * 2);
+    for (s64 i = 0; i < threads.count; ++i) {
+        thread_init(&threads[i], i < pairs ? producer_proc : consumer_proc);
+        threads[i].data = &d;
+    }
+
+    auto start = get_seconds();
+
+    for (auto& t : threads) thread_start(&t);
+    for (auto& t : threads) thread_is_done(&t, -1);
+
+    auto elapsed = get_seconds() - start;
+
+    for (auto& t : threads) thread_deinit(&t);
+    dealloc(threads.data);
+
+    deinit(&d.spsc);
+    deinit(&d.mpmc);
+    destroy(&d.list.semaphore);
+    destroy(&d.list.mutex);
+
+    auto expected = pairs * items_per_side * (items_per_side + 1) / 2;
+    if (d.sum != expected) printf("  WRONG SUM\n");
+
+    return (f64)(pairs * items_per_side) / elapsed;
+}
+
+int main() {
+    CONST_VAR s64 ITEMS = 1000000;
+
+    printf("one producer -> one consumer, %ld items (items/sec)\n", ITEMS);
+    printf("%16s %16s %16s\n", "locked list", "spsc channel", "mpmc channel");
+    printf("%16.0f %16.0f %16.0f\n", bench_channel(Channel_Kind::LOCKED_LIST, 1, ITEMS), bench_channel(Channel_Kind::SPSC, 1, ITEMS), bench_channel(Channel_Kind::MPMC, 1, ITEMS));
+
+    printf("\nN producers -> N consumers, %ld items per producer (items/sec)\n", ITEMS / 4);
+    printf("%8s %16s %16s\n", "pairs", "locked list", "mpmc channel");
+
+    for (s64 pairs = 1; pairs <= 8; pairs *= 2) {
+        auto locked = bench_channel(Channel_Kind::LOCKED_LIST, pairs, ITEMS / 4);
+        auto mpmc   = bench_channel(Channel_Kind::MPMC,        pairs, ITEMS / 4);
+        printf("%8ld %16.0f %16.0f\n", pairs, locked, mpmc);
+    }
+}
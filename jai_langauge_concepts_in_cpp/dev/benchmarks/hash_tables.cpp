@@ -0,0 +1,318 @@
+// Hash table benchmarks, run with: .build/hash_tables
+// Hash_Table vs. Swiss_Table with u32 keys and values: inserting N keys (growing from empty), then looking
+// them up in random order, looking up keys that aren't there, and a miss-heavy mix (90% misses).
+// Sizes that wouldn't fit in the memory we have get skipped.
+// Then Hash_Table churn: counting keys with find + add vs. one table_find_or_add, and a sliding window of keys
+// (add one, remove the oldest) where tombstones pile up until table_remove rehashes in place.
+// Then insert latency while growing: Hash_Table rehashes everything at once, Incremental_Hash_Table spreads it out.
+// Last, several threads sharing one table (90% lookups, 10% find_or_add): Hash_Table behind a Mutex vs.
+// Concurrent_Hash_Table.
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+
+#include "Basic/module.hpp"
+#include "Threads/module.hpp"
+#include "Hash_Table.hpp"
+#include "Swiss_Table.hpp"
+#include "Incremental_Hash_Table.hpp"
+#include "Concurrent_Hash_Table.hpp"
+
+auto get_seconds() -> f64 {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Multiplying by an odd constant is a bijection on u32, so keys for different i never collide.
+// Inserted keys use i in [0, n), misses use i in [n, 2n).
+auto bench_key(u64 i) -> u32 {
+    return (u32)(i * 2654435761u);
+}
+
+auto get_available_memory() -> s64 {
+    auto file = fopen("/proc/meminfo", "r");
+    if (!file) return -1;
+    defer { fclose(file); };
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        long kb = {};
+        if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1) return (s64) kb * 1024;
+    }
+    return -1;
+}
+
+struct Table_Result {
+    bool skipped = {};
+    f64  insert  = {}; // ns per operation
+    f64  hit     = {};
+    f64  miss    = {};
+    f64  mixed   = {};
+};
+
+// Both tables hold twice their final size while they grow, and Hash_Table is 70% full at most:
+template<typename Table>
+auto get_footprint(s64 n) -> s64;
+
+template<>
+auto get_footprint<Hash_Table<u32, u32>>(s64 n) -> s64 {
+    return next_pow2(n * 100 / 70 + 1) * (s64) sizeof(Hash_Table<u32, u32>::Entry) * 3 / 2;
+}
+
+template<>
+auto get_footprint<Swiss_Table<u32, u32>>(s64 n) -> s64 {
+    return next_pow2(n * 8 / 7 + 1) * ((s64) sizeof(Swiss_Table<u32, u32>::Slot) + 1) * 3 / 2;
+}
+
+template<typename Table>
+auto bench_table(s64 n, s64 lookups) -> Table_Result {
+    Table_Result result;
+
+    auto available = get_available_memory();
+    if (available > 0 && get_footprint<Table>(n) > available * 3 / 4) {
+        result.skipped = true;
+        return result;
+    }
+
+    Table table;
+    table_init(&table);
+
+    auto start = get_seconds();
+    for (s64 i = 0; i < n; ++i) table_add(&table, bench_key((u64) i), (u32) i);
+    result.insert = (get_seconds() - start) * 1e9 / (f64) n;
+
+    u64 x   = 12345;
+    u64 sum = {};
+
+    start = get_seconds();
+    for (s64 i = 0; i < lookups; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto value = table_find_pointer(&table, bench_key((x >> 20) % (u64) n));
+        sum += value ? *value : 0;
+    }
+    result.hit = (get_seconds() - start) * 1e9 / (f64) lookups;
+
+    start = get_seconds();
+    for (s64 i = 0; i < lookups; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto value = table_find_pointer(&table, bench_key((u64) n + (x >> 20) % (u64) n));
+        sum += value ? *value : 1;
+    }
+    result.miss = (get_seconds() - start) * 1e9 / (f64) lookups;
+
+    start = get_seconds();
+    for (s64 i = 0; i < lookups; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto index = (x >> 20) % (u64) n + ((x >> 8) % 10 ? (u64) n : 0);
+        auto value = table_find_pointer(&table, bench_key(index));
+        sum += value ? *value : 1;
+    }
+    result.mixed = (get_seconds() - start) * 1e9 / (f64) lookups;
+
+    if (sum == 42) printf(" "); // keep the lookups alive
+
+    table_deinit(&table);
+    return result;
+}
+
+void print_result(const char* name, Table_Result r) {
+    if (r.skipped) printf("%14s %12s\n", name, "skipped, not enough memory");
+    else           printf("%14s %12.2f %12.2f %12.2f %12.2f\n", name, r.insert, r.hit, r.miss, r.mixed);
+}
+
+// Counting occurrences of n distinct keys, each seen "repeats" times:
+template<bool Use_Find_Or_Add>
+auto bench_counting(s64 n, s64 repeats) -> f64 {
+    Hash_Table<u32, u32> table;
+    table_init(&table);
+    defer { table_deinit(&table); };
+
+    u64 x = 12345;
+
+    auto start = get_seconds();
+    for (s64 i = 0; i < n * repeats; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto key = bench_key((x >> 20) % (u64) n);
+
+        if (Use_Find_Or_Add) {
+            *table_find_or_add(&table, key) += 1;
+        } else {
+            auto value = table_find_pointer(&table, key);
+            if (value) *value += 1;
+            else       table_add(&table, key, 1u);
+        }
+    }
+    return (get_seconds() - start) * 1e9 / (f64)(n * repeats);
+}
+
+// "window" keys live at a time, every operation adds a new one and removes the oldest:
+auto bench_window(s64 window, s64 operations) -> f64 {
+    Hash_Table<u32, u32> table;
+    table_init(&table);
+    defer { table_deinit(&table); };
+
+    for (s64 i = 0; i < window; ++i) table_add(&table, bench_key((u64) i), (u32) i);
+
+    auto start = get_seconds();
+    for (s64 i = window; i < window + operations; ++i) {
+        table_add(&table, bench_key((u64) i), (u32) i);
+        table_remove(&table, bench_key((u64)(i - window)));
+    }
+    return (get_seconds() - start) * 1e9 / (f64) operations;
+}
+
+struct Latency_Result {
+    f64 mean = {}; // ns
+    f64 p99  = {};
+    f64 p999 = {};
+    f64 max  = {};
+};
+
+// Times every single insert of n keys into a table growing from empty:
+template<typename Table>
+auto bench_insert_latency(s64 n) -> Latency_Result {
+    Table table;
+    table_init(&table);
+    defer { table_deinit(&table); };
+
+    auto latencies = NewArray<f32>(n, false);
+    defer { dealloc(latencies.data, n * (s64) sizeof(f32)); };
+
+    auto total_start = get_seconds();
+    for (s64 i = 0; i < n; ++i) {
+        auto start = get_seconds();
+        table_add(&table, bench_key((u64) i), (u32) i);
+        latencies[i] = (f32)((get_seconds() - start) * 1e9);
+    }
+
+    Latency_Result result;
+    result.mean = (get_seconds() - total_start) * 1e9 / (f64) n;
+
+    std::sort(latencies.data, latencies.data + n);
+    result.p99  = latencies[n * 99 / 100];
+    result.p999 = latencies[n * 999 / 1000];
+    result.max  = latencies[n - 1];
+    return result;
+}
+
+void print_latency(const char* name, Latency_Result r) {
+    printf("%24s %12.2f %12.2f %12.2f %14.2f\n", name, r.mean, r.p99, r.p999, r.max);
+}
+
+struct Shared_Table_Data {
+    bool                             concurrent = {};
+    s64                              operations = {};
+    s64                              keys       = {};
+
+    Mutex                            mutex      = {};
+    Hash_Table<u32, u32>             locked     = {};
+    Concurrent_Hash_Table<u32, u32>  shared     = {};
+
+    std::atomic<u64>                 sink       = {};
+};
+
+auto shared_table_proc(Thread* thread) -> s64 {
+    auto& d = *(Shared_Table_Data*) thread->data;
+
+    u64 x   = (u64)(size_t) &x;
+    u64 sum = {};
+
+    for (s64 i = 0; i < d.operations; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto key    = bench_key((x >> 20) % (u64) d.keys);
+        bool lookup = (x >> 8) % 10 != 0;
+
+        if (d.concurrent) {
+            auto value = lookup ? table_find_pointer(&d.shared, key) : table_find_or_add(&d.shared, key, key);
+            sum += value ? *value : 0;
+        } else {
+            lock(&d.mutex);
+            auto value = lookup ? table_find_pointer(&d.locked, key) : table_find_or_add(&d.locked, key);
+            if (value && !lookup) *value = key;
+            sum += value ? *value : 0;
+            unlock(&d.mutex);
+        }
+    }
+
+    d.sink.fetch_add(sum, std::memory_order_relaxed);
+    return 0;
+}
+
+// Returns nanoseconds per operation (total time over all threads' operations):
+auto bench_shared_table(bool concurrent, s64 num_threads, s64 operations, s64 keys) -> f64 {
+    auto data = New<Shared_Table_Data>();
+    defer { dealloc(data, (s64) sizeof(Shared_Table_Data)); };
+
+    auto& d = *data;
+    d.concurrent = concurrent;
+    d.operations = operations;
+    d.keys       = keys;
+
+    init(&d.mutex, "shared table");
+    table_init(&d.locked);
+    table_init(&d.shared);
+
+    auto threads = NewArray<Thread>(num_threads);
+    for (auto& t : threads) {
+        thread_init(&t, shared_table_proc);
+        t.data = &d;
+    }
+
+    auto start = get_seconds();
+
+    for (auto& t : threads) thread_start(&t);
+    for (auto& t : threads) thread_is_done(&t, -1);
+
+    auto elapsed = get_seconds() - start;
+
+    for (auto& t : threads) thread_deinit(&t);
+    dealloc(threads.data, num_threads * (s64) sizeof(Thread));
+
+    table_deinit(&d.locked);
+    table_deinit(&d.shared);
+    destroy(&d.mutex);
+
+    return elapsed * 1e9 / (f64)(num_threads * operations);
+}
+
+int main() {
+    CONST_VAR s64 LOOKUPS = 10000000;
+
+    s64 sizes[] = {1000, 1000000, 100000000};
+
+    for (auto n : sizes) {
+        printf("%ld entries (ns per operation)\n", n);
+        printf("%14s %12s %12s %12s %12s\n", "", "insert", "hit", "miss", "90% miss");
+
+        print_result("Hash_Table",  bench_table<Hash_Table<u32, u32>>(n, LOOKUPS));
+        print_result("Swiss_Table", bench_table<Swiss_Table<u32, u32>>(n, LOOKUPS));
+        printf("\n");
+    }
+
+    s64 churn_sizes[] = {1000, 1000000};
+
+    printf("Hash_Table churn (ns per operation)\n");
+    for (auto n : churn_sizes) {
+        printf("%9ld keys: find + add %8.2f, find_or_add %8.2f, add + remove window %8.2f\n", n,
+               bench_counting<false>(n, 10), bench_counting<true>(n, 10), bench_window(n, LOOKUPS));
+    }
+    printf("\n");
+
+    CONST_VAR s64 LATENCY_INSERTS = 4000000;
+
+    printf("%ld inserts, latency including the timer (ns)\n", LATENCY_INSERTS);
+    printf("%24s %12s %12s %12s %14s\n", "", "mean", "p99", "p99.9", "max");
+    print_latency("Hash_Table",             bench_insert_latency<Hash_Table<u32, u32>>(LATENCY_INSERTS));
+    print_latency("Incremental_Hash_Table", bench_insert_latency<Incremental_Hash_Table<u32, u32>>(LATENCY_INSERTS));
+    printf("\n");
+
+    CONST_VAR s64 SHARED_OPERATIONS = 2000000;
+    CONST_VAR s64 SHARED_KEYS       = 1000000;
+
+    printf("Shared table, %ld keys, 90%% lookups (ns per operation)\n", SHARED_KEYS);
+    printf("%8s %22s %22s\n", "threads", "Hash_Table + Mutex", "Concurrent_Hash_Table");
+    for (s64 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        auto locked     = bench_shared_table(false, num_threads, SHARED_OPERATIONS, SHARED_KEYS);
+        auto concurrent = bench_shared_table(true,  num_threads, SHARED_OPERATIONS, SHARED_KEYS);
+        printf("%8ld %22.2f %22.2f\n", num_threads, locked, concurrent);
+    }
+}
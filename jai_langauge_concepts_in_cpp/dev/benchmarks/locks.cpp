@@ -0,0 +1,151 @@
+// Lock benchmarks, run with: .build/locks
+// Every thread takes the lock around a critical section of a few dozen nanoseconds.
+#include <cstdio>
+#include <chrono>
+
+#include "Basic/module.hpp"
+#include "Threads/module.hpp"
+
+auto get_seconds() -> f64 {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A small table the critical section reads or updates:
+CONST_VAR s64 TABLE_SIZE = 16;
+
+struct Bench_Data {
+    Mutex          mutex          = {};
+    Spin_Mutex     spin_mutex     = {};
+    Adaptive_Mutex adaptive_mutex = {};
+    RW_Lock        rw_lock        = {};
+
+    s64            table[TABLE_SIZE];
+    s64            kind           = {};
+    s64            iterations     = {};
+    s64            write_percent  = {};
+    std::atomic<s64> sink         = {};
+};
+
+void write_table(Bench_Data* d, u64 x) {
+    for (s64 i = 0; i < TABLE_SIZE; ++i) d->table[i] += (s64)((x >> i) & 1);
+}
+
+auto read_table(Bench_Data* d) -> s64 {
+    s64 sum = {};
+    for (s64 i = 0; i < TABLE_SIZE; ++i) sum += d->table[i];
+    return sum;
+}
+
+template<typename Lock>
+void run_exclusive(Bench_Data* d, Lock* l) {
+    u64 x   = (u64)(size_t) &x;
+    s64 sum = {};
+
+    for (s64 i = 0; i < d->iterations; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        lock(l);
+        if ((s64)(x >> 33) % 100 < d->write_percent) write_table(d, x);
+        else                                         sum += read_table(d);
+        unlock(l);
+    }
+
+    d->sink.fetch_add(sum, std::memory_order_relaxed);
+}
+
+void run_rw(Bench_Data* d) {
+    u64 x   = (u64)(size_t) &x;
+    s64 sum = {};
+
+    for (s64 i = 0; i < d->iterations; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+
+        if ((s64)(x >> 33) % 100 < d->write_percent) {
+            write_lock(&d->rw_lock);
+            write_table(d, x);
+            write_unlock(&d->rw_lock);
+        } else {
+            read_lock(&d->rw_lock);
+            sum += read_table(d);
+            read_unlock(&d->rw_lock);
+        }
+    }
+
+    d->sink.fetch_add(sum, std::memory_order_relaxed);
+}
+
+auto bench_proc(Thread* thread) -> s64 {
+    auto d = (Bench_Data*) thread->data;
+
+    switch (d->kind) {
+        case 0: run_exclusive(d, &d->mutex);          break;
+        case 1: run_exclusive(d, &d->spin_mutex);     break;
+        case 2: run_exclusive(d, &d->adaptive_mutex); break;
+        case 3: run_rw(d);                            break;
+    }
+
+    return 0;
+}
+
+// Returns nanoseconds per lock/unlock pair:
+auto bench_lock(s64 kind, s64 num_threads, s64 iterations, s64 write_percent) -> f64 {
+    Bench_Data d;
+    init(&d.mutex,          "bench mutex");
+    init(&d.spin_mutex,     "bench spin mutex");
+    init(&d.adaptive_mutex, "bench adaptive mutex");
+    init(&d.rw_lock,        "bench rw lock");
+    memset(d.table, 0, sizeof(d.table));
+
+    d.kind          = kind;
+    d.iterations    = iterations;
+    d.write_percent = write_percent;
+
+    auto threads = NewArray<Thread>(num_threads);
+    for (auto& t : threads) {
+        thread_init(&t, bench_proc);
+        t.data = &d;
+    }
+
+    auto start = get_seconds();
+
+    for (auto& t : threads) thread_start(&t);
+    for (auto& t : threads) thread_is_done(&t, -1);
+
+    auto elapsed = get_seconds() - start;
+
+    for (auto& t : threads) thread_deinit(&t);
+    dealloc(threads.data);
+
+#ifdef DEBUG_LOCKS
+    Lock_Debug* debugs[] = {&d.mutex.debug, &d.spin_mutex.debug, &d.adaptive_mutex.debug, &d.rw_lock.debug};
+    auto& debug = *debugs[kind];
+    printf("    %s: %ld acquisitions, %ld contended, %ld sleeps\n", debug.name, debug.acquisitions.load(), debug.contended.load(), debug.sleeps.load());
+#endif
+
+    destroy(&d.mutex);
+
+    return elapsed * 1e9 / (f64)(num_threads * iterations);
+}
+
+int main() {
+    CONST_VAR s64 ITERATIONS = 1000000;
+
+    printf("exclusive locks, all writes (ns per lock/unlock)\n");
+    printf("%8s %14s %14s %14s\n", "threads", "Mutex", "Spin_Mutex", "Adaptive_Mutex");
+
+    for (s64 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        auto mutex    = bench_lock(0, num_threads, ITERATIONS, 100);
+        auto spin     = bench_lock(1, num_threads, ITERATIONS, 100);
+        auto adaptive = bench_lock(2, num_threads, ITERATIONS, 100);
+        printf("%8ld %14.1f %14.1f %14.1f\n", num_threads, mutex, spin, adaptive);
+    }
+
+    printf("\nread-mostly table, 5%% writes (ns per lock/unlock)\n");
+    printf("%8s %14s %14s\n", "threads", "Mutex", "RW_Lock");
+
+    for (s64 num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        auto mutex = bench_lock(0, num_threads, ITERATIONS, 5);
+        auto rw    = bench_lock(3, num_threads, ITERATIONS, 5);
+        printf("%8ld %14.1f %14.1f\n", num_threads, mutex, rw);
+    }
+}
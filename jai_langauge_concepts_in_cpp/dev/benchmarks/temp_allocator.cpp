@@ -0,0 +1,229 @@
+// Temp_Allocator reset benchmarks, run with: .build/temp_allocator
+// A worker-like loop: every "job" grabs a varying amount of temp memory, then the temp allocator is reset
+// (like thread_group_run() does after every job). Compares the old reset (unmap everything and map a fresh
+// high_water_mark sized pool whenever the cycle overflowed) with the current one.
+#include <cstdio>
+#include <chrono>
+
+#include "Basic/module.hpp"
+
+auto get_seconds() -> f64 {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Copy of the old reset_temp_allocator():
+void reset_temp_allocator_old() {
+    auto temp = &context.temp;
+    auto& t   = *temp;
+
+    if (!t.original_memory_base) return;
+
+    if (t.current_memory_base != t.original_memory_base) {
+        deinit(temp);
+        init(temp, t.high_water_mark);
+    }
+
+    t.high_water_mark = 0;
+    t.current_point   = t.current_memory_base;
+}
+
+CONST_VAR s64 CHUNK_SIZE = 4096;
+
+// Allocates "bytes" in page sized chunks and touches each one:
+void do_temp_job(s64 bytes) {
+    push_allocator(context.temp_allocator,
+        for (s64 allocated = 0; allocated < bytes; allocated += CHUNK_SIZE) {
+            auto memory = (u8*) alloc(CHUNK_SIZE);
+            memory[0] = (u8) allocated;
+        }
+    )
+}
+
+struct Job_Result {
+    f64 syscalls_per_job = {};
+    f64 us_per_job       = {};
+};
+
+// Job sizes wander between min_bytes and max_bytes:
+auto bench_jobs(bool old_reset, s64 num_jobs, s64 min_bytes, s64 max_bytes, s64 initial_reserve) -> Job_Result {
+    deinit(&context.temp);
+    context.temp = {};
+    init(&context.temp, initial_reserve);
+
+    u64 x = 12345;
+
+    auto syscalls_before = context.temp.syscalls;
+    auto start           = get_seconds();
+
+    for (s64 i = 0; i < num_jobs; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto bytes = min_bytes + (s64)((x >> 33) % (u64)(max_bytes - min_bytes));
+
+        do_temp_job(bytes);
+
+        if (old_reset) reset_temp_allocator_old();
+        else           reset_temp_allocator();
+    }
+
+    auto elapsed = get_seconds() - start;
+
+    Job_Result result;
+    result.syscalls_per_job = (f64)(context.temp.syscalls - syscalls_before) / (f64) num_jobs;
+    result.us_per_job       = elapsed * 1e6 / (f64) num_jobs;
+    return result;
+}
+
+// How much of the process is backed by transparent huge pages right now (KB):
+auto get_anon_huge_pages_kb() -> s64 {
+    auto file = fopen("/proc/self/smaps_rollup", "r");
+    if (!file) return -1;
+    defer { fclose(file); };
+
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        long kb = {};
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) return kb;
+    }
+    return -1;
+}
+
+struct Walk_Result {
+    f64 init_ms      = {};
+    f64 first_ms     = {}; // first pass, faulting the pages in
+    f64 ns_per_touch = {}; // random touches once everything is faulted in
+    s64 page_size    = {};
+    s64 huge_kb      = {};
+};
+
+// Random reads and writes all over one big temp allocation, the dTLB miss heavy pattern:
+auto bench_walk(Temp_Allocator_Config config, s64 arena_bytes, s64 touches) -> Walk_Result {
+    deinit(&context.temp);
+    context.temp        = {};
+    context.temp.config = &config;
+
+    Walk_Result result;
+
+    auto start = get_seconds();
+    init(&context.temp, arena_bytes + (s64) sizeof(Temp_Allocator::Next_Pool_Footer));
+    result.init_ms = (get_seconds() - start) * 1e3;
+
+    u64* memory = {};
+    auto count  = arena_bytes / (s64) sizeof(u64);
+    push_allocator(context.temp_allocator, memory = (u64*) alloc(arena_bytes);)
+
+    start = get_seconds();
+    for (s64 i = 0; i < count; i += 512) memory[i] = (u64) i;
+    result.first_ms = (get_seconds() - start) * 1e3;
+
+    u64 x   = 12345;
+    u64 sum = {};
+    start = get_seconds();
+    for (s64 i = 0; i < touches; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto& slot = memory[(x >> 20) % (u64) count];
+        sum  += slot;
+        slot  = sum;
+    }
+    result.ns_per_touch = (get_seconds() - start) * 1e9 / (f64) touches;
+
+    result.page_size = context.temp.page_size;
+    result.huge_kb   = get_anon_huge_pages_kb();
+
+    if (sum == 42) printf(" "); // keep the loop alive
+
+    deinit(&context.temp);
+    context.temp = {};
+    return result;
+}
+
+int main() {
+    CONST_VAR s64 NUM_JOBS = 20000;
+    CONST_VAR s64 KB       = 1024;
+    CONST_VAR s64 MB       = 1024 * KB;
+
+    printf("%ld jobs, temp allocator reset after every job\n", NUM_JOBS);
+    printf("%24s %14s %14s %14s %14s\n", "job size / first pool", "old syscalls", "new syscalls", "old us/job", "new us/job");
+
+    struct Scenario { s64 min_bytes; s64 max_bytes; s64 initial_reserve; const char* name; };
+    Scenario scenarios[] = {
+        {16 * KB, 256 * KB, 64 * KB,  "16K-256K / 64K"},
+        {64 * KB, 2 * MB,   256 * KB, "64K-2M / 256K"},
+        {1 * MB,  8 * MB,   1 * MB,   "1M-8M / 1M"},
+        {16 * KB, 256 * KB, 256 * MB, "16K-256K / 256M"},
+    };
+
+    for (auto& s : scenarios) {
+        auto old_reset = bench_jobs(true,  NUM_JOBS, s.min_bytes, s.max_bytes, s.initial_reserve);
+        auto new_reset = bench_jobs(false, NUM_JOBS, s.min_bytes, s.max_bytes, s.initial_reserve);
+        printf("%24s %14.4f %14.4f %14.2f %14.2f\n", s.name, old_reset.syscalls_per_job, new_reset.syscalls_per_job, old_reset.us_per_job, new_reset.us_per_job);
+    }
+
+    // One big cycle, then a long run of small ones: the pages only the big cycle used get decommitted.
+    deinit(&context.temp);
+    context.temp = {};
+    context.temp.shrink_after_cycles = 64;
+
+    do_temp_job(64 * MB);
+    reset_temp_allocator();
+    auto committed_after_spike = context.temp.dirty_limit - context.temp.original_memory_base;
+
+    for (s64 i = 0; i < 100; ++i) {
+        do_temp_job(1 * MB);
+        reset_temp_allocator();
+    }
+    auto committed_after_quiet = context.temp.dirty_limit - context.temp.original_memory_base;
+
+    printf("\nshrink after %ld low usage cycles: committed %ld KB after a 64M cycle, %ld KB after 100 1M cycles\n\n",
+           context.temp.shrink_after_cycles, committed_after_spike / KB, committed_after_quiet / KB);
+
+    // A frame of phases that each need a few MB of scratch, freeing it with a mark after every phase or not at all.
+    // The first pool is small so the unmarked frame overflows into chained pools:
+    CONST_VAR s64 PHASES = 16;
+
+    for (s64 use_marks = 0; use_marks < 2; ++use_marks) {
+        deinit(&context.temp);
+        context.temp = {};
+        init(&context.temp, 8 * MB);
+
+        auto syscalls_before = context.temp.syscalls;
+
+        for (s64 frame = 0; frame < 100; ++frame) {
+            for (s64 phase = 0; phase < PHASES; ++phase) {
+                auto mark = get_temp_mark();
+                do_temp_job(2 * MB + phase * 64 * KB);
+                if (use_marks) set_temp_mark(mark);
+            }
+            reset_temp_allocator();
+        }
+
+        auto committed = context.temp.dirty_limit - context.temp.original_memory_base;
+        auto reserved  = context.temp.original_memory_limit - context.temp.original_memory_base;
+
+        printf("%s %ld phases of ~2M scratch per frame: %ld KB committed, %ld KB reserved, %ld syscalls in 100 frames\n",
+               use_marks ? "marks,   " : "no marks,", PHASES, committed / KB, reserved / KB, context.temp.syscalls - syscalls_before);
+    }
+
+    CONST_VAR s64 WALK_BYTES   = 256 * MB;
+    CONST_VAR s64 WALK_TOUCHES = 20000000;
+
+    printf("\nrandom touches over a %ld MB temp arena\n", WALK_BYTES / MB);
+    printf("%22s %10s %12s %12s %12s %14s\n", "backing", "init ms", "fault ms", "ns/touch", "page size", "THP KB");
+
+    struct Walk_Scenario { Huge_Pages huge_pages; bool prefault; const char* name; };
+    Walk_Scenario walks[] = {
+        {Huge_Pages::NONE,        false, "4K pages"},
+        {Huge_Pages::NONE,        true,  "4K pages, prefault"},
+        {Huge_Pages::TRANSPARENT, false, "transparent 2M"},
+        {Huge_Pages::TRANSPARENT, true,  "transparent, prefault"},
+        {Huge_Pages::EXPLICIT,    false, "hugetlb 2M"},
+    };
+
+    for (auto& w : walks) {
+        Temp_Allocator_Config config;
+        config.huge_pages = w.huge_pages;
+        config.prefault   = w.prefault;
+
+        auto r = bench_walk(config, WALK_BYTES, WALK_TOUCHES);
+        printf("%22s %10.2f %12.2f %12.2f %12ld %14ld\n", w.name, r.init_ms, r.first_ms, r.ns_per_touch, r.page_size, r.huge_kb);
+    }
+}
@@ -0,0 +1,505 @@
+// Thread_Group scheduling benchmarks, run with: .build/thread_group
+#include <cstdio>
+#include <thread>
+#include <chrono>
+
+#include "Basic/module.hpp"
+#include "Threads/module.hpp"
+
+auto get_seconds() -> f64 {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A "tiny job", a few dozen nanoseconds of work:
+std::atomic<s64> jobs_done = {};
+std::atomic<u64> job_sink  = {};
+
+void do_tiny_job(void* work) {
+    auto x = (u64) work;
+    for (s64 i = 0; i < 16; ++i) x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    job_sink.fetch_add(x & 1, std::memory_order_relaxed);
+    jobs_done.fetch_add(1, std::memory_order_relaxed);
+}
+
+void wait_for_jobs(s64 count) {
+    while (jobs_done.load(std::memory_order_acquire) < count) std::this_thread::yield();
+}
+
+// Baseline: a copy of the old scheduling path, one mutex + semaphore protected linked list
+// per worker for available work, and round robin stealing through the same mutexes.
+struct Baseline_List {
+    Semaphore   semaphore = {};
+    Mutex       mutex     = {};
+
+    Work_Entry* first     = {};
+    Work_Entry* last      = {};
+};
+
+void baseline_add(Baseline_List* list, Work_Entry* entry) {
+    auto& l = *list;
+    {
+        lock(&l.mutex);
+        defer { unlock(&l.mutex); };
+
+        if (l.last) l.last->next = entry;
+        else        l.first      = entry;
+        l.last = entry;
+    }
+    signal(&l.semaphore);
+}
+
+auto baseline_get(Baseline_List* list) -> Work_Entry* {
+    auto& l = *list;
+
+    lock(&l.mutex);
+    defer { unlock(&l.mutex); };
+
+    auto result = l.first;
+    if (result) {
+        l.first = result->next;
+        if (!l.first) l.last = nullptr;
+    }
+    return result;
+}
+
+struct Baseline_Pool {
+    Array_View<Baseline_List> available   = {};
+    Array_View<Baseline_List> completed   = {};
+    Array_View<Thread>        threads     = {};
+    std::atomic<bool>         should_exit = {};
+};
+
+auto baseline_run(Thread* thread) -> s64 {
+    auto& pool = *(Baseline_Pool*) thread->data;
+    auto  self = (s64)(thread - pool.threads.data);
+    auto  n    = pool.threads.count;
+
+    Work_Entry* entry = {};
+    while (!pool.should_exit) {
+        if (!entry) {
+            wait_for(&pool.available[self].semaphore);
+            if (pool.should_exit) break;
+            entry = baseline_get(&pool.available[self]);
+        }
+
+        if (entry) {
+            entry->next = {};
+            do_tiny_job(entry->work);
+            baseline_add(&pool.completed[self], entry);
+        }
+
+        entry = baseline_get(&pool.available[self]);
+        if (entry) {
+            wait_for(&pool.available[self].semaphore);
+        } else {
+            for (s64 i = 1; i < n && !entry; ++i) entry = baseline_get(&pool.available[(self + i) % n]);
+        }
+    }
+
+    return 0;
+}
+
+auto bench_baseline(s64 num_threads, s64 num_jobs) -> f64 {
+    Baseline_Pool pool;
+    pool.available = NewArray<Baseline_List>(num_threads);
+    pool.completed = NewArray<Baseline_List>(num_threads);
+    pool.threads   = NewArray<Thread>(num_threads);
+
+    for (s64 i = 0; i < num_threads; ++i) {
+        init(&pool.available[i].semaphore); init(&pool.available[i].mutex);
+        init(&pool.completed[i].semaphore); init(&pool.completed[i].mutex);
+        thread_init(&pool.threads[i], baseline_run);
+        pool.threads[i].data = &pool;
+        thread_start(&pool.threads[i]);
+    }
+
+    jobs_done = 0;
+    auto start = get_seconds();
+
+    for (s64 i = 0; i < num_jobs; ++i) {
+        auto entry  = New<Work_Entry>();
+        entry->work = (void*) i;
+        baseline_add(&pool.available[i % num_threads], entry);
+    }
+    wait_for_jobs(num_jobs);
+
+    auto elapsed = get_seconds() - start;
+
+    pool.should_exit = true;
+    for (auto& list : pool.available) signal(&list.semaphore);
+    for (auto& t : pool.threads) thread_deinit(&t);
+
+    for (auto& list : pool.completed) {
+        while (auto entry = baseline_get(&list)) dealloc(entry);
+    }
+
+    dealloc(pool.available.data);
+    dealloc(pool.completed.data);
+    dealloc(pool.threads.data);
+
+    return (f64) num_jobs / elapsed;
+}
+
+auto tiny_job_proc(Thread_Group*, Thread*, void* work) -> Thread_Continue_Status {
+    do_tiny_job(work);
+    return Thread_Continue_Status::CONTINUE;
+}
+
+auto bench_thread_group(s64 num_threads, s64 num_jobs) -> f64 {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, tiny_job_proc, true);
+    thread_group_start(&group);
+
+    jobs_done = 0;
+    auto start = get_seconds();
+
+    for (s64 i = 0; i < num_jobs; ++i) thread_group_add_work(&group, (void*) i);
+    wait_for_jobs(num_jobs);
+
+    auto elapsed = get_seconds() - start;
+
+    thread_group_get_completed_work(&group);
+    reset_temp_allocator();
+    thread_group_shutdown(&group);
+
+    return (f64) num_jobs / elapsed;
+}
+
+struct Submit_Result {
+    f64                   submit_ns_per_item = {};
+    f64                   items_per_second   = {};
+    Work_Entry_Pool_Stats pool               = {};
+};
+
+// Frame loop like main.cpp: submit a frame's worth of items, wait for them, collect them.
+void print_worker_stats(Thread_Group* group) {
+    printf("%8s %10s %8s %14s %14s %14s %14s %14s\n", "worker", "jobs", "steals", "avg wait us", "max wait us", "avg exec us", "idle ms", "avg collect us");
+    for (auto& s : thread_group_get_stats(group)) {
+        auto jobs = max(s.jobs + s.tasks, (s64) 1);
+        printf("%8ld %10ld %8ld %14.2f %14.2f %14.3f %14.2f %14.2f\n", s.worker_index, s.jobs + s.tasks, s.steals,
+               s.queue_wait * 1e6 / (f64) jobs, s.queue_wait_max * 1e6, s.execution * 1e6 / (f64) jobs, s.idle * 1e3,
+               s.completed_latency * 1e6 / (f64) max(s.collected, (s64) 1));
+    }
+}
+
+auto bench_submit(s64 num_threads, s64 items_per_frame, s64 num_frames, bool use_batch, bool print_stats = false) -> Submit_Result {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, tiny_job_proc, true);
+    thread_group_start(&group);
+
+    auto work = NewArray<void*>(items_per_frame);
+    for (s64 i = 0; i < items_per_frame; ++i) work[i] = (void*) i;
+
+    f64 submit_time = {};
+    jobs_done = 0;
+    auto start = get_seconds();
+
+    for (s64 frame = 0; frame < num_frames; ++frame) {
+        auto submit_start = get_seconds();
+        if (use_batch) {
+            thread_group_add_work_batch(&group, work);
+        } else {
+            for (auto w : work) thread_group_add_work(&group, w);
+        }
+        submit_time += get_seconds() - submit_start;
+
+        wait_for_jobs((frame + 1) * items_per_frame);
+        thread_group_get_completed_work(&group);
+        reset_temp_allocator();
+    }
+
+    auto elapsed = get_seconds() - start;
+
+    Submit_Result result;
+    result.pool = thread_group_get_pool_stats(&group);
+
+    if (print_stats) print_worker_stats(&group);
+
+    thread_group_shutdown(&group);
+    dealloc(work.data);
+
+    result.submit_ns_per_item = submit_time * 1e9 / (f64)(items_per_frame * num_frames);
+    result.items_per_second   = (f64)(items_per_frame * num_frames) / elapsed;
+    return result;
+}
+
+// Round trip latency of one job: submit it, then block until it's collected.
+auto bench_completion_latency(s64 num_threads, s64 num_rounds, bool use_counter) -> f64 {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, tiny_job_proc, true);
+    thread_group_start(&group);
+
+    auto start = get_seconds();
+
+    for (s64 i = 0; i < num_rounds; ++i) {
+        if (use_counter) {
+            Task_Counter counter;
+            thread_group_add_work(&group, (void*) i, &counter);
+            wait_for(&counter);
+            thread_group_get_completed_work(&group);
+        } else {
+            thread_group_add_work(&group, (void*) i);
+            thread_group_get_completed_work(&group, -1);
+        }
+        reset_temp_allocator();
+    }
+
+    auto elapsed = get_seconds() - start;
+
+    thread_group_shutdown(&group);
+
+    return elapsed * 1e6 / (f64) num_rounds;
+}
+
+// Latency of one urgent job submitted behind a backlog of bulk jobs, with the urgent job
+// at the same priority as the backlog vs. marked HIGH with the backlog as BACKGROUND.
+auto bench_priority_latency(s64 num_threads, s64 backlog, s64 num_rounds, bool use_priorities) -> f64 {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, tiny_job_proc, true);
+    thread_group_start(&group);
+
+    auto work = NewArray<void*>(backlog);
+    for (s64 i = 0; i < backlog; ++i) work[i] = (void*) i;
+
+    auto bulk_priority   = use_priorities ? Work_Priority::BACKGROUND : Work_Priority::NORMAL;
+    auto urgent_priority = use_priorities ? Work_Priority::HIGH       : Work_Priority::NORMAL;
+
+    f64 total = {};
+    for (s64 round = 0; round < num_rounds; ++round) {
+        Task_Counter bulk;
+        Task_Counter urgent;
+
+        thread_group_add_work_batch(&group, work, &bulk, bulk_priority);
+
+        auto start = get_seconds();
+        thread_group_add_work(&group, nullptr, &urgent, {}, urgent_priority);
+        wait_for(&urgent);
+        total += get_seconds() - start;
+
+        wait_for(&bulk);
+        thread_group_get_completed_work(&group);
+        reset_temp_allocator();
+    }
+
+    thread_group_shutdown(&group);
+    dealloc(work.data);
+
+    return total * 1e6 / (f64) num_rounds;
+}
+
+// Data parallel pass over a Resizable_Array, the thing parallel_for() is for:
+auto bench_parallel_for(s64 num_threads, Resizable_Array<s64>* values, s64 grain, s64* sum_out) -> f64 {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, nullptr, true);
+    thread_group_start(&group);
+
+    auto& v = *values;
+    std::atomic<s64> sum = {};
+
+    auto start = get_seconds();
+
+    parallel_for(&group, 0, v.count, grain, [&](s64 begin, s64 end) {
+        s64 partial = {};
+        for (auto i = begin; i < end; ++i) partial += v[i] * v[i] % 7;
+        sum.fetch_add(partial, std::memory_order_relaxed);
+    });
+
+    auto elapsed = get_seconds() - start;
+
+    thread_group_shutdown(&group);
+
+    *sum_out = sum;
+    return elapsed;
+}
+
+// Fork/join: recursive fib where every call spawns one half and runs the other itself.
+struct Fib {
+    s64 n      = {};
+    s64 result = {};
+};
+
+void fib_task(Thread_Group* group, void* data) {
+    auto& f = *(Fib*) data;
+
+    if (f.n < 16) {
+        s64 a = 0, b = 1;
+        for (s64 i = 0; i < f.n; ++i) { auto c = a + b; a = b; b = c; }
+        f.result = a;
+        return;
+    }
+
+    Fib left;  left.n  = f.n - 1;
+    Fib right; right.n = f.n - 2;
+
+    Task_Counter counter;
+    task_spawn(group, &counter, fib_task, &left);
+    fib_task(group, &right);
+    task_wait(group, &counter);
+
+    f.result = left.result + right.result;
+}
+
+auto bench_fork_join(s64 num_threads, s64 n, s64* result_out) -> f64 {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, nullptr, true);
+    thread_group_start(&group);
+
+    Fib root;
+    root.n = n;
+
+    auto start = get_seconds();
+
+    Task_Counter counter;
+    task_spawn(&group, &counter, fib_task, &root);
+    task_wait(&group, &counter);
+
+    auto elapsed = get_seconds() - start;
+
+    thread_group_shutdown(&group);
+
+    *result_out = root.result;
+    return elapsed;
+}
+
+// Pipeline of "stages" stages, "width" items each, item i of a stage needs item i of the previous stage.
+// Per stage: submit the stage from the main thread and wait for all of it before the next one,
+// vs. one task graph per frame where each item releases its successor directly.
+void tiny_task(Thread_Group*, void* data) {
+    do_tiny_job(data);
+}
+
+auto bench_pipeline(s64 num_threads, s64 stages, s64 width, s64 num_frames, bool use_graph) -> f64 {
+    Thread_Group group;
+    thread_group_init(&group, num_threads, nullptr, true);
+    thread_group_start(&group);
+
+    jobs_done = 0;
+    auto start = get_seconds();
+
+    for (s64 frame = 0; frame < num_frames; ++frame) {
+        if (use_graph) {
+            Task_Graph graph;
+
+            Array_View<Task_Graph_Node*> previous;
+            push_allocator(context.temp_allocator, previous = NewArray<Task_Graph_Node*>(width);)
+
+            for (s64 stage = 0; stage < stages; ++stage) {
+                for (s64 i = 0; i < width; ++i) {
+                    auto node = task_graph_add(&graph, tiny_task, (void*) i);
+                    if (stage) task_graph_depends_on(node, previous[i]);
+                    previous[i] = node;
+                }
+            }
+
+            task_graph_run(&group, &graph);
+        } else {
+            for (s64 stage = 0; stage < stages; ++stage) {
+                Task_Counter counter;
+                for (s64 i = 0; i < width; ++i) task_spawn(&group, &counter, tiny_task, (void*) i);
+                task_wait(&group, &counter);
+            }
+        }
+
+        reset_temp_allocator();
+    }
+
+    auto elapsed = get_seconds() - start;
+
+    thread_group_shutdown(&group);
+
+    if (jobs_done != stages * width * num_frames) printf("  WRONG JOB COUNT\n");
+    return elapsed * 1e3 / (f64) num_frames;
+}
+
+int main() {
+    CONST_VAR s64 NUM_JOBS = 200000;
+
+    printf("tiny jobs, %ld per run (jobs/sec)\n", NUM_JOBS);
+    printf("%8s %16s %16s %8s\n", "threads", "mutex list", "work deque", "speedup");
+
+    for (s64 num_threads = 1; num_threads <= 64; num_threads *= 2) {
+        auto baseline = bench_baseline(num_threads, NUM_JOBS);
+        auto deque    = bench_thread_group(num_threads, NUM_JOBS);
+        printf("%8ld %16.0f %16.0f %7.2fx\n", num_threads, baseline, deque, deque / baseline);
+    }
+
+    CONST_VAR s64 ITEMS_PER_FRAME = 4096;
+    CONST_VAR s64 NUM_FRAMES      = 50;
+
+    printf("\nframe submission, %ld items per frame (submit ns/item, items/sec)\n", ITEMS_PER_FRAME);
+    printf("%8s %14s %14s %14s %14s %12s %12s\n", "threads", "loop submit", "batch submit", "loop total", "batch total", "pool hits", "pool misses");
+
+    for (s64 num_threads = 1; num_threads <= 64; num_threads *= 2) {
+        auto loop  = bench_submit(num_threads, ITEMS_PER_FRAME, NUM_FRAMES, false);
+        auto batch = bench_submit(num_threads, ITEMS_PER_FRAME, NUM_FRAMES, true);
+        auto hits   = loop.pool.cache_hits + loop.pool.shared_hits + batch.pool.cache_hits + batch.pool.shared_hits;
+        auto misses = loop.pool.misses + batch.pool.misses;
+        printf("%8ld %14.1f %14.1f %14.0f %14.0f %12ld %12ld\n", num_threads, loop.submit_ns_per_item, batch.submit_ns_per_item, loop.items_per_second, batch.items_per_second, hits, misses);
+    }
+
+    printf("\nworker stats, 4 threads, batch submission\n");
+    bench_submit(4, ITEMS_PER_FRAME, NUM_FRAMES, true, true);
+    reset_temp_allocator();
+
+    CONST_VAR s64 LATENCY_ROUNDS = 20000;
+
+    printf("\nsingle job round trip (us)\n");
+    printf("%8s %16s %16s\n", "threads", "counter wait", "completion wait");
+
+    for (s64 num_threads = 1; num_threads <= 64; num_threads *= 2) {
+        auto counter_wait    = bench_completion_latency(num_threads, LATENCY_ROUNDS, true);
+        auto completion_wait = bench_completion_latency(num_threads, LATENCY_ROUNDS, false);
+        printf("%8ld %16.2f %16.2f\n", num_threads, counter_wait, completion_wait);
+    }
+
+    CONST_VAR s64 PRIORITY_BACKLOG = 16384;
+    CONST_VAR s64 PRIORITY_ROUNDS  = 50;
+
+    printf("\nurgent job behind %ld queued jobs (us)\n", PRIORITY_BACKLOG);
+    printf("%8s %16s %16s\n", "threads", "same priority", "high/background");
+
+    for (s64 num_threads = 1; num_threads <= 64; num_threads *= 2) {
+        auto same     = bench_priority_latency(num_threads, PRIORITY_BACKLOG, PRIORITY_ROUNDS, false);
+        auto priority = bench_priority_latency(num_threads, PRIORITY_BACKLOG, PRIORITY_ROUNDS, true);
+        printf("%8ld %16.2f %16.2f\n", num_threads, same, priority);
+    }
+
+    CONST_VAR s64 PIPELINE_STAGES = 8;
+    CONST_VAR s64 PIPELINE_WIDTH  = 256;
+    CONST_VAR s64 PIPELINE_FRAMES = 100;
+
+    printf("\npipeline, %ld stages x %ld items (ms per frame)\n", PIPELINE_STAGES, PIPELINE_WIDTH);
+    printf("%8s %16s %16s\n", "threads", "stage by stage", "task graph");
+
+    for (s64 num_threads = 1; num_threads <= 64; num_threads *= 2) {
+        auto staged = bench_pipeline(num_threads, PIPELINE_STAGES, PIPELINE_WIDTH, PIPELINE_FRAMES, false);
+        auto graph  = bench_pipeline(num_threads, PIPELINE_STAGES, PIPELINE_WIDTH, PIPELINE_FRAMES, true);
+        printf("%8ld %16.3f %16.3f\n", num_threads, staged, graph);
+    }
+
+    CONST_VAR s64 PARALLEL_FOR_COUNT = 1 << 24;
+    CONST_VAR s64 PARALLEL_FOR_GRAIN = 4096;
+    CONST_VAR s64 FIB_N              = 32;
+
+    Resizable_Array<s64> values;
+    array_resize(&values, PARALLEL_FOR_COUNT);
+    for (s64 i = 0; i < values.count; ++i) values[i] = i;
+
+    auto serial_start = get_seconds();
+    s64 serial_sum = {};
+    for (auto x : values) serial_sum += x * x % 7;
+    auto serial = get_seconds() - serial_start;
+
+    printf("\nparallel_for over %ld items (grain %ld) and fork/join fib(%ld) (ms)\n", PARALLEL_FOR_COUNT, PARALLEL_FOR_GRAIN, FIB_N);
+    printf("%8s %14s %14s %14s\n", "threads", "serial", "parallel_for", "fork/join");
+
+    for (s64 num_threads = 1; num_threads <= 64; num_threads *= 2) {
+        s64 sum = {};
+        s64 fib = {};
+        auto pf = bench_parallel_for(num_threads, &values, PARALLEL_FOR_GRAIN, &sum);
+        auto fj = bench_fork_join(num_threads, FIB_N, &fib);
+        printf("%8ld %14.2f %14.2f %14.2f%s\n", num_threads, serial * 1000.0, pf * 1000.0, fj * 1000.0, (sum == serial_sum && fib == 2178309) ? "" : "  WRONG RESULT");
+    }
+
+    array_reset(&values);
+}
@@ -7,5 +7,12 @@ INCLUDES="-Imodules"
 WARNINGS="-Wall -Wextra -Wpedantic -Wconversion -Wshadow"
 EXTRA_OPTIONS="-fno-exceptions"
 
+mkdir -p .build
+
 # Actual build commands:
 g++ $STANDARD $OPTIMIZATION $INCLUDES $WARNINGS $EXTRA_OPTIONS main.cpp -o .build/main
+
+# Benchmarks:
+for BENCHMARK in benchmarks/*.cpp; do
+    g++ $STANDARD $OPTIMIZATION $INCLUDES $WARNINGS $EXTRA_OPTIONS "$BENCHMARK" -o ".build/$(basename "$BENCHMARK" .cpp)"
+done
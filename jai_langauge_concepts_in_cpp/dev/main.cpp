@@ -2,10 +2,10 @@
 #include <vector>
 #include <map>
 #include <cstdio>
-#include <thread>
 
 #include "Basic/module.hpp"
 #include "Hash_Table.hpp"
+#include "Tracking_Allocator.hpp"
 #include "Threads/module.hpp"
 
 // NOTE(WALKER): These overloads below make it to where any "standard"/STL stuff we use
@@ -21,14 +21,14 @@ void* operator new[](std::size_t size) {
 void operator delete(void* memory) {
     dealloc(memory);
 }
-void operator delete(void* memory, std::size_t) {
-    dealloc(memory);
+void operator delete(void* memory, std::size_t size) {
+    dealloc(memory, (s64) size);
 }
 void operator delete[](void* memory) {
     dealloc(memory);
 }
-void operator delete[](void* memory, std::size_t) {
-    dealloc(memory);
+void operator delete[](void* memory, std::size_t size) {
+    dealloc(memory, (s64) size);
 }
 
 struct List_Node {
@@ -82,6 +82,7 @@ auto make_list(s64 count) -> List_Node* {
 // each thread has their own temp_allocator thanks to "thread_local",
 // which means every thread has their own garbage collection mechanism
 void do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage() {
+    allocation_site("make_list"); // only shows up when a Tracking_Allocator is pushed (see main())
     make_list(1000);
     make_list(1000);
     make_list(1000);
@@ -90,6 +91,7 @@ void do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage() {
     make_list(1000);
 
     // Imagine for a second we replaced these with our own implementations (not that hard to do):
+    allocation_site("std containers");
     std::vector<s64> ints;
     for (s64 i = 1; i <= 1000; ++i) {
         ints.emplace_back(i);
@@ -106,6 +108,7 @@ void do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage() {
     // if you don't set the context.allocator correctly (wrapper APIs)
 
     // This is our stuff (arrays and hash table):
+    allocation_site("our containers");
     Resizable_Array<s64> our_ints;
     for (s64 i = 1; i <= 1000; ++i) {
         array_add(&our_ints, i);
@@ -129,9 +132,12 @@ Thread_Group tg = {};
 //               its proc. In other words, each thread has garbage collection
 //               and can write leaky code like below.
 auto thread_group_do_leaky_things(Thread_Group*, Thread*, void*) -> Thread_Continue_Status {
-    printf("thread #%ld before = %p\n", context.thread_index, context.temp.current_point);
     do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage();
-    printf("thread #%ld after  = %p\n", context.thread_index, context.temp.current_point);
+
+    // What this job leaked into the temp allocator, plus the previous job's totals (reset_temp_allocator() keeps those):
+    auto& t = context.temp;
+    printf("thread #%ld temp: %ld bytes this job, last job peaked at %ld bytes with %ld overflow pools, %ld of %ld jobs overflowed\n",
+           context.thread_index, t.high_water_mark, t.last_cycle_peak, t.last_cycle_overflows, t.overflowed_cycles, t.cycles);
 
     return Thread_Continue_Status::CONTINUE;
 }
@@ -148,20 +154,36 @@ int main() {
 
     // Main program loop here:
     context.allocator = context.temp_allocator;
-    while (true) {
+    for (s64 frame = 0; true; ++frame) {
         defer { reset_temp_allocator(); }; // temp acts as a garbage collector for your while(true) loop (fire and forget)
+        trace_scope("main frame");
+
+        // Build with -DENABLE_TRACE to get a chrome://tracing / Perfetto view of the first few frames:
+        if (frame == 60) trace_write_chrome_json("trace.json");
 
         // Rest of your main program loop (doing dumb leaky stuff):
-        printf("main before = %p\n", context.temp.current_point);
-        do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage();
-        printf("main after  = %p\n", context.temp.current_point);
+        // The first frame goes through a Tracking_Allocator to show what all of that actually allocates:
+        if (frame == 0) {
+            Tracking_Allocator tracker;
+            init(&tracker, true);
+            push_allocator(tracking_allocator(&tracker), do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage();)
+            print_tracking_report(&tracker);
+            deinit(&tracker);
+        } else {
+            do_some_really_dumb_leaky_stuff_that_is_hard_to_memory_manage();
+        }
+        printf("main temp: %ld bytes this frame, last frame peaked at %ld bytes with %ld overflow pools\n",
+               context.temp.high_water_mark, context.temp.last_cycle_peak, context.temp.last_cycle_overflows);
 
         // Have Thread_Group do some work:
+        Task_Counter frame_work;
         for (s64 i = 0; i < tg.worker_info.count; ++i) {
-            thread_group_add_work(&tg, nullptr);
+            thread_group_add_work(&tg, nullptr, &frame_work);
         }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds{1000});
+        // Wakes up as soon as the last piece is done, no polling. No timeout, the work entries
+        // point at frame_work so we can't leave this scope before they are all done:
+        wait_for(&frame_work);
 
         thread_group_get_completed_work(&tg);
     }
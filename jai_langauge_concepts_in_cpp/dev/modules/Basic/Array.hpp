@@ -7,7 +7,7 @@ void array_reserve_nonpoly(Resizable_Array<void*>* arr, s64 desired_items, s64 s
     if (!a.allocator.proc) remember_allocators(arr);
 
     push_allocator(a.allocator,
-        a.data = (void**) realloc(a.data, desired_items + size, a.allocated + size);
+        a.data = (void**) realloc(a.data, desired_items * size, a.allocated * size);
     )
 
     a.allocated = desired_items;
@@ -27,14 +27,14 @@ void maybe_grow(Resizable_Array<T>* arr) {
 template<typename T>
 void array_dealloc(Resizable_Array<T>* arr) {
     auto& a = *arr;
-    push_allocator(a.allocator, dealloc(a.data);)
+    push_allocator(a.allocator, dealloc(a.data, a.allocated * (s64) sizeof(T));)
 }
 
 template<typename T>
 void array_reset(Resizable_Array<T>* arr) {
     auto& a = *arr;
 
-    push_allocator(a.allocator, dealloc(a.data);)
+    push_allocator(a.allocator, dealloc(a.data, a.allocated * (s64) sizeof(T));)
 
     a.count     = {};
     a.data      = {};
@@ -0,0 +1,348 @@
+// Heap_Allocator: a general purpose malloc/free replacement.
+// Every thread gets its own Heap (its thread cache), so the common alloc/free never takes a lock.
+// Small requests are rounded up to one of HEAP_SIZE_CLASS_COUNT size classes, each class is carved out of
+// HEAP_SEGMENT_SIZE aligned segments owned by one heap, which makes finding a block's segment (and with it
+// its size and owner) a mask of the pointer. Freeing somebody else's block pushes it onto the owner's
+// remote free list, the owner takes those back the next time it runs out of a class.
+// Big requests get their own mapping, which also lets realloc() grow them in place with mremap().
+//
+// Build with -DUSE_HEAP_ALLOCATOR to make it Context::default_allocator.
+
+#include <sys/mman.h>
+#include <sched.h>
+
+CONST_VAR s64 HEAP_SEGMENT_SIZE          = 256 * 1024;
+CONST_VAR s64 HEAP_SEGMENT_HEADER_SIZE   = 128;       // blocks start this far into a segment, keeps them 16 byte aligned
+CONST_VAR s64 HEAP_MAX_SMALL_SIZE        = 32 * 1024; // anything bigger gets its own mapping
+CONST_VAR s64 HEAP_SIZE_CLASS_COUNT      = 40;        // 16..128 in steps of 16, then 4 classes per power of two
+CONST_VAR s64 HEAP_LARGE                 = -1;        // size_class of a segment holding one big allocation
+CONST_VAR s64 HEAP_EMPTY_SEGMENT_CACHE   = 8;         // empty segments a heap holds on to before unmapping them
+CONST_VAR s64 HEAP_OS_PAGE_SIZE          = 4096;
+
+struct Heap;
+
+struct Heap_Block {
+    Heap_Block* next = {};
+};
+
+struct Heap_Segment {
+    Heap*         owner       = {};
+    s64           size_class  = {};
+    s64           block_size  = {};
+    s64           mapped_size = {}; // the whole mapping, only used by HEAP_LARGE ones
+
+    Heap_Block*   free_list   = {};
+    u8*           bump_point  = {}; // blocks below this were handed out at some point
+    u8*           limit       = {};
+    s64           used        = {};
+
+    // Segments with room are linked into their heap's available list:
+    bool          full        = {};
+    Heap_Segment* prev        = {};
+    Heap_Segment* next        = {};
+};
+
+static_assert(sizeof(Heap_Segment) <= HEAP_SEGMENT_HEADER_SIZE, "Heap_Segment header doesn't fit");
+
+struct Heap {
+    Heap_Segment*            available[HEAP_SIZE_CLASS_COUNT] = {};
+    Heap_Segment*            empty_segments                   = {};
+    s64                      empty_count                      = {};
+    Heap*                    next_abandoned                   = {};
+
+    u8                       padding[CACHE_LINE_SIZE];        // other threads hammer the line below
+
+    std::atomic<Heap_Block*> remote_frees                     = {};
+};
+
+// Heaps outlive their threads: an exiting thread leaves its heap here and the next new thread adopts it,
+// so blocks still out there always have an owner to go back to.
+std::atomic_flag heap_abandoned_lock = ATOMIC_FLAG_INIT;
+Heap*            heap_abandoned      = {};
+
+thread_local Heap* thread_heap        = {};
+thread_local bool  thread_heap_exited = {};
+
+// Size classes:
+auto heap_size_class(s64 size) -> s64 {
+    if (size <= 128) return size <= 16 ? 0 : (size + 15) / 16 - 1;
+
+    auto s     = (u64)(size - 1);
+    auto b     = 63 - __builtin_clzll(s);
+    auto shift = b - 2;
+    return 8 + (b - 7) * 4 + (s64)((s >> shift) & 3);
+}
+
+auto heap_class_size(s64 size_class) -> s64 {
+    if (size_class < 8) return (size_class + 1) * 16;
+
+    auto b = 7 + (size_class - 8) / 4;
+    auto q =     (size_class - 8) % 4;
+    return ((s64)1 << b) + (q + 1) * ((s64)1 << (b - 2));
+}
+
+auto heap_segment_of(void* memory) -> Heap_Segment* {
+    return (Heap_Segment*)((u64) memory & ~(u64)(HEAP_SEGMENT_SIZE - 1));
+}
+
+// Maps "size" bytes starting on a HEAP_SEGMENT_SIZE boundary:
+auto heap_map_segment(s64 size) -> u8* {
+    auto raw_size = size + HEAP_SEGMENT_SIZE;
+    auto raw      = mmap(nullptr, (u64) raw_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+
+    auto base = align_pow2((u8*) raw, HEAP_SEGMENT_SIZE);
+    auto end  = base + size;
+
+    if (base > (u8*) raw)                { munmap(raw, (u64)(base - (u8*) raw)); }
+    if (end  < (u8*) raw + raw_size)     { munmap(end, (u64)((u8*) raw + raw_size - end)); }
+
+    return base;
+}
+
+// Heaps:
+struct Heap_Thread_Exit {
+    ~Heap_Thread_Exit() {
+        auto heap = thread_heap;
+        if (!heap) return;
+
+        thread_heap        = nullptr;
+        thread_heap_exited = true;
+
+        while (heap_abandoned_lock.test_and_set(std::memory_order_acquire)) sched_yield();
+        heap->next_abandoned = heap_abandoned;
+        heap_abandoned       = heap;
+        heap_abandoned_lock.clear(std::memory_order_release);
+    }
+};
+
+auto get_thread_heap_slow() -> Heap* {
+    Heap* heap = {};
+
+    while (heap_abandoned_lock.test_and_set(std::memory_order_acquire)) sched_yield();
+    if (heap_abandoned) {
+        heap           = heap_abandoned;
+        heap_abandoned = heap->next_abandoned;
+    }
+    heap_abandoned_lock.clear(std::memory_order_release);
+
+    if (!heap) {
+        auto memory = mmap(nullptr, sizeof(Heap), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return nullptr;
+        heap = new (memory) Heap;
+    }
+
+    heap->next_abandoned = nullptr;
+    thread_heap          = heap;
+
+    // Hands the heap back when the thread exits (frees during thread_local destruction after that go remote):
+    if (!thread_heap_exited) {
+        static thread_local Heap_Thread_Exit thread_exit;
+        (void) thread_exit;
+    }
+
+    return heap;
+}
+
+auto get_thread_heap() -> Heap* {
+    auto heap = thread_heap;
+    return heap ? heap : get_thread_heap_slow();
+}
+
+// Segment lists:
+void heap_link_available(Heap* heap, Heap_Segment* segment) {
+    auto& head = heap->available[segment->size_class];
+
+    segment->full = false;
+    segment->prev = nullptr;
+    segment->next = head;
+    if (head) head->prev = segment;
+    head = segment;
+}
+
+void heap_unlink_available(Heap* heap, Heap_Segment* segment) {
+    if (segment->prev) segment->prev->next                   = segment->next;
+    else               heap->available[segment->size_class]  = segment->next;
+    if (segment->next) segment->next->prev                   = segment->prev;
+
+    segment->prev = nullptr;
+    segment->next = nullptr;
+}
+
+auto heap_new_segment(Heap* heap, s64 size_class) -> Heap_Segment* {
+    auto& h = *heap;
+
+    u8* memory = {};
+    if (h.empty_segments) {
+        memory           = (u8*) h.empty_segments;
+        h.empty_segments = h.empty_segments->next;
+        h.empty_count   -= 1;
+    } else {
+        memory = heap_map_segment(HEAP_SEGMENT_SIZE);
+        if (!memory) return nullptr;
+    }
+
+    auto segment         = new (memory) Heap_Segment;
+    segment->owner       = heap;
+    segment->size_class  = size_class;
+    segment->block_size  = heap_class_size(size_class);
+    segment->mapped_size = HEAP_SEGMENT_SIZE;
+    segment->bump_point  = memory + HEAP_SEGMENT_HEADER_SIZE;
+    segment->limit       = memory + HEAP_SEGMENT_HEADER_SIZE + ((HEAP_SEGMENT_SIZE - HEAP_SEGMENT_HEADER_SIZE) / segment->block_size) * segment->block_size;
+
+    heap_link_available(heap, segment);
+    return segment;
+}
+
+void heap_release_segment(Heap* heap, Heap_Segment* segment) {
+    auto& h = *heap;
+
+    heap_unlink_available(heap, segment);
+
+    if (h.empty_count < HEAP_EMPTY_SEGMENT_CACHE) {
+        segment->next    = h.empty_segments;
+        h.empty_segments = segment;
+        h.empty_count   += 1;
+    } else {
+        munmap(segment, (u64) HEAP_SEGMENT_SIZE);
+    }
+}
+
+// Owner side free:
+void heap_free_local(Heap* heap, Heap_Segment* segment, void* memory) {
+    auto block         = (Heap_Block*) memory;
+    block->next        = segment->free_list;
+    segment->free_list = block;
+    segment->used     -= 1;
+
+    if (segment->full) heap_link_available(heap, segment);
+
+    if (segment->used == 0 && (segment->prev || segment->next)) {
+        // Empty, and not the last one of its class (which we keep around so one alloc/free doesn't map/unmap):
+        heap_release_segment(heap, segment);
+    }
+}
+
+// Takes back everything other threads freed for us:
+void heap_collect_remote_frees(Heap* heap) {
+    auto block = heap->remote_frees.exchange(nullptr, std::memory_order_acquire);
+
+    while (block) {
+        auto next = block->next;
+        heap_free_local(heap, heap_segment_of(block), block);
+        block = next;
+    }
+}
+
+// Big ones:
+auto heap_alloc_large(s64 size) -> void* {
+    auto mapped = align_pow2(size + HEAP_SEGMENT_HEADER_SIZE, HEAP_OS_PAGE_SIZE);
+    auto memory = heap_map_segment(mapped);
+    if (!memory) return nullptr;
+
+    auto segment         = new (memory) Heap_Segment;
+    segment->size_class  = HEAP_LARGE;
+    segment->block_size  = mapped - HEAP_SEGMENT_HEADER_SIZE;
+    segment->mapped_size = mapped;
+
+    return memory + HEAP_SEGMENT_HEADER_SIZE;
+}
+
+// Public API:
+auto heap_alloc(s64 size) -> void* {
+    if (size > HEAP_MAX_SMALL_SIZE) return heap_alloc_large(size);
+
+    auto heap = get_thread_heap();
+    if (!heap) return nullptr;
+
+    auto size_class = heap_size_class(size);
+    auto segment    = heap->available[size_class];
+
+    if (!segment) {
+        heap_collect_remote_frees(heap);
+
+        segment = heap->available[size_class];
+        if (!segment) segment = heap_new_segment(heap, size_class);
+        if (!segment) return nullptr;
+    }
+
+    void* result = {};
+    if (segment->free_list) {
+        result             = segment->free_list;
+        segment->free_list = segment->free_list->next;
+    } else {
+        result               = segment->bump_point;
+        segment->bump_point += segment->block_size;
+    }
+    segment->used += 1;
+
+    if (!segment->free_list && segment->bump_point == segment->limit) {
+        heap_unlink_available(heap, segment);
+        segment->full = true;
+    }
+
+    return result;
+}
+
+void heap_free(void* memory) {
+    if (!memory) return;
+
+    auto segment = heap_segment_of(memory);
+
+    if (segment->size_class == HEAP_LARGE) {
+        munmap(segment, (u64) segment->mapped_size);
+        return;
+    }
+
+    if (segment->owner == thread_heap) {
+        heap_free_local(segment->owner, segment, memory);
+        return;
+    }
+
+    // Somebody else's, hand it back to them:
+    auto& remote_frees = segment->owner->remote_frees;
+    auto  block        = (Heap_Block*) memory;
+    block->next        = remote_frees.load(std::memory_order_relaxed);
+    while (!remote_frees.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed)) {}
+}
+
+// How many bytes "memory" really has room for:
+auto heap_usable_size(void* memory) -> s64 {
+    return heap_segment_of(memory)->block_size;
+}
+
+auto heap_realloc(void* memory, s64 size) -> void* {
+    if (!memory) return heap_alloc(size);
+
+    auto segment = heap_segment_of(memory);
+    auto usable  = segment->block_size;
+
+    if (size <= usable) return memory;
+
+    // Try to extend the mapping where it is (moving it could break the segment alignment):
+    if (segment->size_class == HEAP_LARGE) {
+        auto mapped = align_pow2(size + HEAP_SEGMENT_HEADER_SIZE, HEAP_OS_PAGE_SIZE);
+        if (mremap(segment, (u64) segment->mapped_size, (u64) mapped, 0) != MAP_FAILED) {
+            segment->mapped_size = mapped;
+            segment->block_size  = mapped - HEAP_SEGMENT_HEADER_SIZE;
+            return memory;
+        }
+    }
+
+    auto result = heap_alloc(size);
+    if (result) {
+        memcpy(result, memory, (u64) usable);
+        heap_free(memory);
+    }
+    return result;
+}
+
+auto heap_allocator_proc(Allocator_Mode mode, s64 requested_size, s64, void* old_memory, void*) -> void* {
+    switch(mode) {
+        case ALLOCATE:   { return heap_alloc(requested_size); }
+        case REALLOCATE: { return heap_realloc(old_memory, requested_size); }
+        case DEALLOCATE: { heap_free(old_memory); break; }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,156 @@
+// Pool_Allocator: lots of blocks of one size (list nodes, tree nodes, entries...).
+// Blocks get carved out of big slabs (taken from the allocator remembered at init()), freed blocks go on an
+// intrusive free list, so both alloc and dealloc are a couple of pointer moves and never touch malloc.
+// release_all() frees every block at once and keeps the slabs for reuse, deinit() hands the slabs back.
+//
+// Use it like any other allocator:
+//     Pool_Allocator pool;
+//     init(&pool, sizeof(List_Node));
+//     push_allocator(pool_allocator(&pool), ...)
+//
+// NOTE(WALKER): Not thread safe, give each thread its own pool (like the temp allocator).
+//               Requests bigger than block_size fail (return null), so don't grow arrays out of one.
+
+CONST_VAR s64 DEFAULT_POOL_BLOCKS_PER_SLAB = 256;
+
+struct Pool_Allocator {
+    struct Free_Block {
+        Free_Block* next  = {};
+    };
+
+    struct Slab {
+        Slab*       next  = {};
+        s64         count = {}; // blocks in this slab
+    };
+
+    s64         block_size      = {};
+    s64         alignment       = 8;
+    s64         blocks_per_slab = DEFAULT_POOL_BLOCKS_PER_SLAB;
+
+    Free_Block* free_list       = {};
+
+    // Slabs are used up in list order, blocks of the current one are handed out bump style first:
+    Slab*       slabs           = {};
+    Slab*       current_slab    = {};
+    u8*         current_point   = {};
+    u8*         current_limit   = {};
+
+    s64         slab_count      = {};
+    s64         blocks_in_use   = {};
+
+    Allocator   allocator       = {}; // where the slabs come from
+};
+
+void init(Pool_Allocator* pool, s64 block_size, s64 blocks_per_slab = DEFAULT_POOL_BLOCKS_PER_SLAB, s64 alignment = 8) {
+    auto& p = *pool;
+
+    remember_allocators(pool);
+
+    p.alignment       = max(alignment, (s64) alignof(Pool_Allocator::Free_Block));
+    p.block_size      = align_pow2(max(block_size, (s64) sizeof(Pool_Allocator::Free_Block)), p.alignment);
+    p.blocks_per_slab = max(blocks_per_slab, (s64) 1);
+}
+
+// The remembered allocator only promises 16 byte alignment, so every slab leaves room to align its first block:
+auto get_pool_slab_size(Pool_Allocator* pool, s64 count) -> s64 {
+    return (s64) sizeof(Pool_Allocator::Slab) + pool->alignment + pool->block_size * count;
+}
+
+void deinit(Pool_Allocator* pool) {
+    auto& p = *pool;
+
+    while (p.slabs) {
+        auto next = p.slabs->next;
+        auto size = get_pool_slab_size(pool, p.slabs->count);
+        push_allocator(p.allocator, dealloc(p.slabs, size);)
+        p.slabs = next;
+    }
+
+    p.free_list     = {};
+    p.current_slab  = {};
+    p.current_point = {};
+    p.current_limit = {};
+    p.slab_count    = {};
+    p.blocks_in_use = {};
+}
+
+// Moves on to the next slab, allocating one when we are at the end of the list:
+void next_pool_slab(Pool_Allocator* pool) {
+    auto& p = *pool;
+
+    auto slab = p.current_slab ? p.current_slab->next : p.slabs;
+    if (!slab) {
+        push_allocator(p.allocator, slab = (Pool_Allocator::Slab*) alloc(get_pool_slab_size(pool, p.blocks_per_slab));)
+        slab->next  = nullptr;
+        slab->count = p.blocks_per_slab;
+
+        if (p.current_slab) p.current_slab->next = slab;
+        else                p.slabs              = slab;
+        p.slab_count += 1;
+    }
+
+    p.current_slab  = slab;
+    p.current_point = align_pow2((u8*) slab + sizeof(Pool_Allocator::Slab), p.alignment);
+    p.current_limit = p.current_point + p.block_size * slab->count;
+}
+
+void* get(Pool_Allocator* pool) {
+    auto& p = *pool;
+
+    p.blocks_in_use += 1;
+
+    if (p.free_list) {
+        auto block  = p.free_list;
+        p.free_list = block->next;
+        return block;
+    }
+
+    if (p.current_point == p.current_limit) next_pool_slab(pool);
+
+    auto result      = p.current_point;
+    p.current_point += p.block_size;
+    return result;
+}
+
+void release(Pool_Allocator* pool, void* memory) {
+    auto& p = *pool;
+
+    if (!memory) return;
+
+    auto block  = (Pool_Allocator::Free_Block*) memory;
+    block->next = p.free_list;
+    p.free_list = block;
+
+    p.blocks_in_use -= 1;
+}
+
+// Frees every block at once, the slabs stay around for the next round:
+void release_all(Pool_Allocator* pool) {
+    auto& p = *pool;
+
+    p.free_list     = {};
+    p.current_slab  = {};
+    p.current_point = {};
+    p.current_limit = {};
+    p.blocks_in_use = {};
+}
+
+auto pool_allocator_proc(Allocator_Mode mode, s64 requested_size, s64, void* old_memory, void* allocator_data) -> void* {
+    auto pool = (Pool_Allocator*) allocator_data;
+    auto& p   = *pool;
+
+    switch(mode) {
+        case ALLOCATE:   { return requested_size <= p.block_size ? get(pool) : nullptr; }
+        case REALLOCATE: {
+            if (requested_size <= p.block_size) return old_memory ? old_memory : get(pool);
+            break;
+        }
+        case DEALLOCATE: { release(pool, old_memory); break; }
+    }
+
+    return nullptr;
+}
+
+auto pool_allocator(Pool_Allocator* pool) -> Allocator {
+    return Allocator{&pool_allocator_proc, pool};
+}
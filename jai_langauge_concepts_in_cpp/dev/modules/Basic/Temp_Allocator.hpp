@@ -3,7 +3,16 @@
 
 #define DEFAULT_TEMP_ALLOCATOR_VIRTUAL_MEMORY_RESERVE 256 *  1024 * 1024 // 256 Megabytes
 
-CONST_VAR s64 TEMP_ALLOCATOR_PAGE_SIZE = 4096; // NOTE(WALKER): If we control the hardware and operating system, we can look into 2MB Huge Pages for this instead of the standard 4K.
+CONST_VAR s64 TEMP_ALLOCATOR_PAGE_SIZE = 4096;
+CONST_VAR s64 HUGE_PAGE_SIZE           = 2 * 1024 * 1024; // see Temp_Allocator_Config for backing pools with these
+
+// A cycle counts as "low usage" when it used less than 1/TEMP_ALLOCATOR_LOW_USAGE_DIVISOR of the committed pages:
+CONST_VAR s64 TEMP_ALLOCATOR_LOW_USAGE_DIVISOR = 4;
+
+// MADV_FREE is cheaper, but the pages only leave RSS once the kernel is under memory pressure:
+#ifndef TEMP_ALLOCATOR_DECOMMIT_ADVICE
+#define TEMP_ALLOCATOR_DECOMMIT_ADVICE MADV_DONTNEED
+#endif
 
 // struct Temp_Allocator {
 //     s64 alignment             = 8;
@@ -24,45 +33,142 @@ CONST_VAR s64 TEMP_ALLOCATOR_PAGE_SIZE = 4096; // NOTE(WALKER): If we control th
 //     };
 // };
 
+// Maps a pool of at least "reserve" bytes with the huge page/prefault settings in effect for "temp",
+// "reserve" comes back as the size actually mapped. Returns null when even a plain mapping fails.
+// NOTE(WALKER): With prefault, size the reserve to what you'll really use, every byte of it gets committed.
+auto map_temp_pool(Temp_Allocator* temp, s64* reserve) -> u8* {
+    auto& t      = *temp;
+    auto& config = t.config ? *t.config : default_temp_allocator_config;
+
+    if (config.huge_pages == Huge_Pages::EXPLICIT) {
+        auto size  = align_pow2(*reserve, HUGE_PAGE_SIZE);
+        auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (config.prefault ? MAP_POPULATE : 0);
+        auto base  = mmap(nullptr, (u64)size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        t.syscalls += 1;
+
+        if (base != MAP_FAILED) {
+            *reserve    = size;
+            t.page_size = HUGE_PAGE_SIZE;
+            return (u8*) base;
+        }
+        // Not enough reserved huge pages, go on with transparent ones:
+    }
+
+    if (config.huge_pages != Huge_Pages::NONE) {
+        // Transparent huge pages only cover 2MB aligned ranges, so map one extra and trim the ends:
+        auto size     = align_pow2(*reserve, HUGE_PAGE_SIZE);
+        auto raw_size = size + HUGE_PAGE_SIZE;
+        auto raw      = mmap(nullptr, (u64)raw_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        t.syscalls   += 1;
+
+        if (raw != MAP_FAILED) {
+            auto base = align_pow2((u8*) raw, HUGE_PAGE_SIZE);
+            auto end  = base + size;
+
+            if (base > (u8*) raw)            { munmap(raw, (u64)(base - (u8*) raw));            t.syscalls += 1; }
+            if (end < (u8*) raw + raw_size)  { munmap(end, (u64)((u8*) raw + raw_size - end)); t.syscalls += 1; }
+
+            madvise(base, (u64)size, MADV_HUGEPAGE);
+            t.syscalls += 1;
+
+            // MAP_POPULATE would have faulted it in with small pages before the madvise, touch it ourselves instead:
+            if (config.prefault) {
+                for (auto p = base; p < end; p += TEMP_ALLOCATOR_PAGE_SIZE) *(volatile u8*) p = 0;
+            }
+
+            *reserve    = size;
+            t.page_size = HUGE_PAGE_SIZE;
+            return base;
+        }
+        // Not even the extra 2MB to align with, try a plain mapping of just what was asked for:
+    }
+
+    *reserve = align_pow2(*reserve, TEMP_ALLOCATOR_PAGE_SIZE);
+    auto flags = MAP_PRIVATE | MAP_ANONYMOUS | (config.prefault ? MAP_POPULATE : 0);
+    auto base  = mmap(nullptr, (u64)*reserve, PROT_READ | PROT_WRITE, flags, -1, 0);
+    t.syscalls += 1;
+
+    if (base == MAP_FAILED) return nullptr;
+
+    t.page_size = TEMP_ALLOCATOR_PAGE_SIZE;
+    return (u8*) base;
+}
+
 // Public API:
 void init(Temp_Allocator* temp, s64 reserve = DEFAULT_TEMP_ALLOCATOR_VIRTUAL_MEMORY_RESERVE) {
     auto& t = *temp;
 
-         reserve = align_pow2(reserve, TEMP_ALLOCATOR_PAGE_SIZE);
-    auto base    = mmap(nullptr, (u64)reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+    auto base = map_temp_pool(temp, &reserve);
+    if (!base) return; // stays uninitialized, get() tries again and returns null if it still can't
 
     t.original_memory_base  = (u8*) base;
     t.original_memory_limit = t.original_memory_base + reserve - sizeof(Temp_Allocator::Next_Pool_Footer);
     t.current_memory_base   = t.original_memory_base;
     t.current_memory_limit  = t.original_memory_limit;
     t.current_point         = t.current_memory_base;
+
+    t.dirty_limit           = t.original_memory_base;
+    t.low_usage_cycles      = 0;
+    t.low_usage_peak        = 0;
 }
 
-void deinit(Temp_Allocator* temp) {
+// Unmaps the pool at base..limit and every pool chained on after it:
+void free_temp_pools(Temp_Allocator* temp, u8* base, u8* limit) {
     auto& t = *temp;
 
-    while (t.original_memory_base) {
-        auto& footer            = *(Temp_Allocator::Next_Pool_Footer*)(t.original_memory_limit);
+    while (base) {
+        auto& footer           = *(Temp_Allocator::Next_Pool_Footer*)(limit);
 
-        auto next_memory_base   = footer.next_memory_base;
-        auto next_memory_limit  = footer.next_memory_limit;
+        auto next_memory_base  = footer.next_memory_base;
+        auto next_memory_limit = footer.next_memory_limit;
 
-        munmap(t.original_memory_base, (u64)(t.original_memory_limit - t.original_memory_base));
+        munmap(base, (u64)(limit - base) + sizeof(Temp_Allocator::Next_Pool_Footer));
+        t.syscalls += 1;
 
-        t.original_memory_base  = next_memory_base;
-        t.original_memory_limit = next_memory_limit;
+        base  = next_memory_base;
+        limit = next_memory_limit;
     }
 }
 
-void grow_temp(Temp_Allocator* temp, s64 nbytes) {
+void deinit(Temp_Allocator* temp) {
+    auto& t = *temp;
+
+    free_temp_pools(temp, t.original_memory_base, t.original_memory_limit);
+
+    t.original_memory_base  = {};
+    t.original_memory_limit = {};
+}
+
+// Returns false (and leaves the current pool as it was) when there's no memory for another pool:
+auto grow_temp(Temp_Allocator* temp, s64 nbytes) -> bool {
+    trace_scope("grow_temp");
+
     auto& t = *temp;
 
-    auto& footer             = *(Temp_Allocator::Next_Pool_Footer*)(t.original_memory_limit);
+    t.cycle_overflows += 1;
 
-    auto reserve             = align_pow2((s64)(t.current_memory_limit - t.current_memory_base + sizeof(Temp_Allocator::Next_Pool_Footer)) * 2, TEMP_ALLOCATOR_PAGE_SIZE);
-         reserve             = max(reserve, align_pow2(nbytes, TEMP_ALLOCATOR_PAGE_SIZE));
+    // Chained onto the end of the pool we are leaving:
+    auto& footer             = *(Temp_Allocator::Next_Pool_Footer*)(t.current_memory_limit);
 
-    auto base                = mmap(nullptr, (u64)reserve, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0);
+    // set_temp_mark() rewound us out of the pools after this one, they are still chained on. Step into the next
+    // one again if it is big enough, otherwise it (and everything after it) makes room for a bigger one:
+    if (footer.next_memory_base) {
+        if (footer.next_memory_limit - footer.next_memory_base >= nbytes) {
+            t.current_memory_base  = footer.next_memory_base;
+            t.current_memory_limit = footer.next_memory_limit;
+            t.current_point        = t.current_memory_base;
+            return true;
+        }
+
+        free_temp_pools(temp, footer.next_memory_base, footer.next_memory_limit);
+        footer = {};
+    }
+
+    auto reserve             = (s64)(t.current_memory_limit - t.current_memory_base + sizeof(Temp_Allocator::Next_Pool_Footer)) * 2;
+         reserve             = max(reserve, nbytes + (s64)sizeof(Temp_Allocator::Next_Pool_Footer));
+
+    auto base                = map_temp_pool(temp, &reserve);
+    if (!base) return false;
 
     t.current_memory_base    = (u8*) base;
     t.current_memory_limit   = t.current_memory_base + reserve - sizeof(Temp_Allocator::Next_Pool_Footer);
@@ -70,6 +176,8 @@ void grow_temp(Temp_Allocator* temp, s64 nbytes) {
 
     footer.next_memory_base  = t.current_memory_base;
     footer.next_memory_limit = t.current_memory_limit;
+
+    return true;
 }
 
 void* get_unaligned(Temp_Allocator* temp, s64 nbytes) {
@@ -77,13 +185,14 @@ void* get_unaligned(Temp_Allocator* temp, s64 nbytes) {
 
     if (!t.original_memory_base) {
         init(temp, max(nbytes + (s64)sizeof(Temp_Allocator::Next_Pool_Footer), (s64)(DEFAULT_TEMP_ALLOCATOR_VIRTUAL_MEMORY_RESERVE)));
+        if (!t.original_memory_base) return nullptr;
     }
 
     auto result = t.current_point;
     auto end    = result + nbytes;
 
     if (end > t.current_memory_limit) {
-        grow_temp(temp, nbytes);
+        if (!grow_temp(temp, nbytes)) return nullptr;
 
         result = t.current_point;
         end    = result + nbytes;
@@ -100,17 +209,18 @@ void* get(Temp_Allocator* temp, s64 nbytes) {
 
     if (!t.original_memory_base) {
         init(temp, max(nbytes + (s64)sizeof(Temp_Allocator::Next_Pool_Footer), (s64)(DEFAULT_TEMP_ALLOCATOR_VIRTUAL_MEMORY_RESERVE)));
+        if (!t.original_memory_base) return nullptr;
     }
 
-    align_pow2(t.current_point, t.alignment);
+    t.current_point = align_pow2(t.current_point, t.alignment);
 
     auto result = t.current_point;
     auto end    = result + nbytes;
 
     if (end > t.current_memory_limit) {
-        grow_temp(temp, nbytes);
+        if (!grow_temp(temp, nbytes + t.alignment)) return nullptr;
 
-        align_pow2(t.current_point, t.alignment);
+        t.current_point = align_pow2(t.current_point, t.alignment);
 
         result = t.current_point;
         end    = result + nbytes;
@@ -129,14 +239,118 @@ void reset_temp_allocator() {
 
     if (!t.original_memory_base) return;
 
-    // Recombine pools into one big pool:
-    if (t.current_memory_base != t.original_memory_base) {
+    trace_scope("reset_temp_allocator");
+
+    t.last_cycle_peak      = max(t.cycle_peak, t.high_water_mark);
+    t.last_cycle_overflows = t.cycle_overflows;
+    t.max_cycle_peak       = max(t.max_cycle_peak, t.last_cycle_peak);
+    t.overflowed_cycles   += t.cycle_overflows ? 1 : 0;
+    t.cycles              += 1;
+
+    // A mark may have rewound us into the original pool after this cycle overflowed, the chain says whether it did:
+    auto& footer = *(Temp_Allocator::Next_Pool_Footer*)(t.original_memory_limit);
+
+    if (t.current_memory_base != t.original_memory_base || footer.next_memory_base) {
+        // This cycle didn't fit, recombine the pools into one that would have. It at least doubles,
+        // so a slowly growing workload only pays for this a handful of times instead of every cycle:
+        auto old_reserve = (s64)(t.original_memory_limit - t.original_memory_base) + (s64)sizeof(Temp_Allocator::Next_Pool_Footer);
+        auto needed      = t.last_cycle_peak + t.last_cycle_peak / 4 + (s64)sizeof(Temp_Allocator::Next_Pool_Footer); // room for alignment
+        auto reserve     = old_reserve * 2;
+        while (reserve < needed) reserve *= 2;
+
         deinit(temp);
-        init(temp, t.high_water_mark);
+        init(temp, reserve);
+    } else {
+        // Same pool as last cycle, keep it (and its committed pages) around. Only once usage has stayed low
+        // for shrink_after_cycles cycles in a row, hand the pages above the largest of those cycles back to the OS:
+        auto peak     = max(t.peak_point, t.current_point);
+        auto used     = (s64)(peak - t.original_memory_base);
+        t.dirty_limit = max(t.dirty_limit, peak);
+
+        if (used * TEMP_ALLOCATOR_LOW_USAGE_DIVISOR < (s64)(t.dirty_limit - t.original_memory_base)) {
+            t.low_usage_cycles += 1;
+            t.low_usage_peak    = max(t.low_usage_peak, used);
+
+            if (t.low_usage_cycles >= t.shrink_after_cycles) {
+                auto keep = align_pow2(t.original_memory_base + t.low_usage_peak, t.page_size);
+                if (keep < t.dirty_limit) {
+                    madvise(keep, (u64)(t.dirty_limit - keep), TEMP_ALLOCATOR_DECOMMIT_ADVICE);
+                    t.syscalls   += 1;
+                    t.dirty_limit = keep;
+                }
+
+                t.low_usage_cycles = 0;
+                t.low_usage_peak   = 0;
+            }
+        } else {
+            t.low_usage_cycles = 0;
+            t.low_usage_peak   = 0;
+        }
     }
 
-    t.high_water_mark = 0;
-    t.current_point   = t.current_memory_base;
+    t.high_water_mark      = 0;
+    t.current_point        = t.current_memory_base;
+    t.peak_point           = {};
+    t.cycle_peak           = 0;
+    t.cycle_overflows      = 0;
+}
+
+// Marks: everything allocated from the temp allocator after get_temp_mark() is freed again by set_temp_mark(),
+// so a phase can hand its scratch memory back before the end of the cycle:
+//     auto mark = get_temp_mark();
+//     ... temp allocations ...
+//     set_temp_mark(mark);
+// or scoped, like push_allocator():
+//     push_temp_mark(
+//         ... temp allocations ...
+//     )
+// NOTE(WALKER): Marks are only good until the next reset_temp_allocator(), and setting one frees everything
+// allocated after it, including what any marks taken later were guarding.
+struct Temp_Mark {
+    u8* memory_base     = {};
+    u8* memory_limit    = {};
+    u8* current_point   = {};
+    s64 high_water_mark = {};
+};
+
+auto get_temp_mark() -> Temp_Mark {
+    auto& t = context.temp;
+
+    Temp_Mark mark;
+    mark.memory_base     = t.current_memory_base;
+    mark.memory_limit    = t.current_memory_limit;
+    mark.current_point   = t.current_point;
+    mark.high_water_mark = t.high_water_mark;
+    return mark;
+}
+
+void set_temp_mark(Temp_Mark mark) {
+    auto& t = context.temp;
+
+    if (!t.original_memory_base) return;
+
+    // Taken before the first allocation, back to the very start:
+    if (!mark.memory_base) {
+        mark.memory_base   = t.original_memory_base;
+        mark.memory_limit  = t.original_memory_limit;
+        mark.current_point = t.original_memory_base;
+    }
+
+    // Remember how far into the original pool we got, for reset_temp_allocator() deciding what to decommit:
+    if (t.current_memory_base == t.original_memory_base) t.peak_point = max(t.peak_point, t.current_point);
+    t.cycle_peak = max(t.cycle_peak, t.high_water_mark);
+
+    // The pools chained on after the marked one stay mapped, grow_temp() steps back into them:
+    t.current_memory_base  = mark.memory_base;
+    t.current_memory_limit = mark.memory_limit;
+    t.current_point        = mark.current_point;
+    t.high_water_mark      = mark.high_water_mark;
+}
+
+#define push_temp_mark(...) {                     \
+    auto temp_mark = get_temp_mark();             \
+    defer { set_temp_mark(temp_mark); };          \
+    { __VA_ARGS__ }                               \
 }
 
 auto temp_allocator_proc(Allocator_Mode mode, s64 requested_size, s64 old_size, void* old_memory, void*) -> void* {
@@ -158,12 +372,22 @@ auto temp_allocator_proc(Allocator_Mode mode, s64 requested_size, s64 old_size,
         } __attribute__ ((fallthrough)); // [[fallthrough]]:
         case ALLOCATE:   {
             auto result = get(temp, requested_size);
+            if (!result) return nullptr; // couldn't map another pool, the old block stays valid
+
             if (mode == REALLOCATE && old_memory) {
                 memcpy(result, old_memory, old_size);
             }
             return result;
         }
-        case DEALLOCATE: { break; }
+        case DEALLOCATE: {
+            // Only the last allocation can be given back, everything else waits for the reset:
+            if (old_size && t.current_point - old_size == (u8*) old_memory) {
+                t.cycle_peak       = max(t.cycle_peak, t.high_water_mark);
+                t.current_point    = (u8*) old_memory;
+                t.high_water_mark -= old_size;
+            }
+            break;
+        }
     }
 
     return nullptr;
@@ -0,0 +1,114 @@
+// Opt-in tracing: #define ENABLE_TRACE above "Basic/module.hpp" (or build with -DENABLE_TRACE).
+// trace_scope("name") records how long the rest of the scope took into a per-thread ring buffer,
+// trace_write_chrome_json() dumps every thread's buffer in the Chrome trace format
+// (load it in chrome://tracing or ui.perfetto.dev).
+// When ENABLE_TRACE isn't defined trace_scope() expands to nothing.
+
+#ifdef ENABLE_TRACE
+
+#include <cstdio>
+#include <time.h>
+
+CONST_VAR s64 TRACE_BUFFER_CAPACITY = 1 << 16; // events per thread, oldest get overwritten
+
+struct Trace_Event {
+    const char* name         = {};
+    s64         begin_ns     = {};
+    s64         end_ns       = {};
+    s64         thread_index = {};
+};
+
+struct Trace_Buffer {
+    Trace_Buffer*    next   = {};
+    std::atomic<s64> count  = {};
+    Trace_Event      events[TRACE_BUFFER_CAPACITY];
+};
+
+// Every thread's buffer, buffers are never freed so a flush can always walk them:
+std::atomic<Trace_Buffer*> trace_buffers = {};
+thread_local Trace_Buffer* trace_buffer  = {};
+
+auto trace_now_ns() -> s64 {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (s64) now.tv_sec * 1000000000 + (s64) now.tv_nsec;
+}
+
+// NOTE(WALKER): Buffers come straight from malloc, not context.allocator, since tracing
+//               runs inside the allocators themselves.
+auto get_trace_buffer() -> Trace_Buffer* {
+    if (trace_buffer) return trace_buffer;
+
+    auto buffer = (Trace_Buffer*) malloc(sizeof(Trace_Buffer));
+    new (buffer) Trace_Buffer;
+
+    auto head = trace_buffers.load(std::memory_order_relaxed);
+    do {
+        buffer->next = head;
+    } while (!trace_buffers.compare_exchange_weak(head, buffer, std::memory_order_release, std::memory_order_relaxed));
+
+    trace_buffer = buffer;
+    return buffer;
+}
+
+void trace_record(const char* name, s64 begin_ns, s64 end_ns) {
+    auto& b = *get_trace_buffer();
+
+    auto  index = b.count.load(std::memory_order_relaxed);
+    auto& event = b.events[index & (TRACE_BUFFER_CAPACITY - 1)];
+
+    event.name         = name;
+    event.begin_ns     = begin_ns;
+    event.end_ns       = end_ns;
+    event.thread_index = context.thread_index;
+
+    b.count.store(index + 1, std::memory_order_release);
+}
+
+struct Trace_Scope {
+    const char* name     = {};
+    s64         begin_ns = {};
+
+    Trace_Scope(const char* scope_name) : name(scope_name), begin_ns(trace_now_ns()) {}
+    ~Trace_Scope() { trace_record(name, begin_ns, trace_now_ns()); }
+};
+
+// "name" has to outlive the trace (string literals are what you want here)
+#define trace_scope(name) Trace_Scope GEN_DEFER_NAME(_trace_scope_, __COUNTER__)(name)
+
+// NOTE(WALKER): Call this at a quiet point (between frames, after shutdown), events being written
+//               while we read them can come out torn.
+auto trace_write_chrome_json(const char* file_path) -> bool {
+    auto file = fopen(file_path, "w");
+    if (!file) return false;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (auto b = trace_buffers.load(std::memory_order_acquire); b; b = b->next) {
+        auto count = b->count.load(std::memory_order_acquire);
+        auto start = max(count - TRACE_BUFFER_CAPACITY, (s64) 0);
+
+        for (auto i = start; i < count; ++i) {
+            auto& event = b->events[i & (TRACE_BUFFER_CAPACITY - 1)];
+
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.name, event.thread_index,
+                    (f64) event.begin_ns / 1000.0, (f64)(event.end_ns - event.begin_ns) / 1000.0);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    return true;
+}
+
+#else
+
+#define trace_scope(name)
+
+auto trace_write_chrome_json(const char*) -> bool { return false; }
+
+#endif
@@ -0,0 +1,138 @@
+// Virtual_Arena: a bump allocator over one big contiguous reservation.
+// init() only reserves address space (PROT_NONE, nothing committed), pages get committed with mprotect
+// in commit_chunk sized steps as the arena grows into them. Since the range never moves there are no
+// pools to chain or recombine, and the last page of the reservation is never committed, so running
+// off the end faults right away instead of scribbling over whatever comes next.
+//
+// Use it like any other allocator:
+//     Virtual_Arena arena;
+//     init(&arena);
+//     push_allocator(virtual_arena_allocator(&arena), ...)
+
+#define DEFAULT_VIRTUAL_ARENA_RESERVE (64LL * 1024 * 1024 * 1024) // 64 Gigabytes of address space, costs nothing until committed
+
+CONST_VAR s64 VIRTUAL_ARENA_PAGE_SIZE    = 4096;
+CONST_VAR s64 VIRTUAL_ARENA_COMMIT_CHUNK = 64 * 1024;
+
+struct Virtual_Arena {
+    s64 alignment       = 8;
+    s64 commit_chunk    = VIRTUAL_ARENA_COMMIT_CHUNK;
+    s64 high_water_mark = {};
+
+    u8* base            = {};
+    u8* current_point   = {};
+    u8* commit_limit    = {}; // readable/writable below this
+    u8* reserve_limit   = {}; // the guard page starts here
+};
+
+auto init(Virtual_Arena* arena, s64 reserve = DEFAULT_VIRTUAL_ARENA_RESERVE) -> bool {
+    auto& a = *arena;
+
+    reserve = align_pow2(reserve, VIRTUAL_ARENA_PAGE_SIZE);
+
+    auto base = mmap(nullptr, (u64)(reserve + VIRTUAL_ARENA_PAGE_SIZE), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return false;
+
+    a.base            = (u8*) base;
+    a.current_point   = a.base;
+    a.commit_limit    = a.base;
+    a.reserve_limit   = a.base + reserve;
+    a.high_water_mark = 0;
+
+    return true;
+}
+
+void deinit(Virtual_Arena* arena) {
+    auto& a = *arena;
+
+    if (a.base) munmap(a.base, (u64)(a.reserve_limit - a.base + VIRTUAL_ARENA_PAGE_SIZE));
+
+    a.base          = {};
+    a.current_point = {};
+    a.commit_limit  = {};
+    a.reserve_limit = {};
+}
+
+// Makes everything below "end" usable:
+auto commit(Virtual_Arena* arena, u8* end) -> bool {
+    auto& a = *arena;
+
+    if (end <= a.commit_limit) return true;
+    if (end >  a.reserve_limit) return false;
+
+    auto new_limit = min(align_pow2(end, max(a.commit_chunk, VIRTUAL_ARENA_PAGE_SIZE)), a.reserve_limit);
+    if (mprotect(a.commit_limit, (u64)(new_limit - a.commit_limit), PROT_READ | PROT_WRITE) != 0) return false;
+
+    a.commit_limit = new_limit;
+    return true;
+}
+
+// Returns null when the reservation is used up:
+void* get(Virtual_Arena* arena, s64 nbytes) {
+    auto& a = *arena;
+
+    if (!a.base && !init(arena)) return nullptr;
+
+    auto result = align_pow2(a.current_point, a.alignment);
+    auto end    = result + nbytes;
+
+    if (end > a.commit_limit && !commit(arena, end)) return nullptr;
+
+    a.current_point   = end;
+    a.high_water_mark = max(a.high_water_mark, (s64)(end - a.base));
+
+    return result;
+}
+
+// Frees everything at once. With "decommit" the pages go back to the OS too (the reservation stays),
+// otherwise they stay committed for the next cycle.
+void reset(Virtual_Arena* arena, bool decommit = false) {
+    auto& a = *arena;
+
+    a.current_point = a.base;
+
+    if (decommit && a.commit_limit > a.base) {
+        madvise(a.base, (u64)(a.commit_limit - a.base), MADV_DONTNEED);
+        mprotect(a.base, (u64)(a.commit_limit - a.base), PROT_NONE);
+        a.commit_limit = a.base;
+    }
+}
+
+auto virtual_arena_allocator_proc(Allocator_Mode mode, s64 requested_size, s64 old_size, void* old_memory, void* allocator_data) -> void* {
+    auto arena = (Virtual_Arena*) allocator_data;
+    auto& a    = *arena;
+
+    switch(mode) {
+        case REALLOCATE: {
+            if (requested_size <= old_size) return old_memory;
+
+            // Last allocation, just move the end:
+            if (a.current_point - old_size == (u8*) old_memory) {
+                auto end = (u8*) old_memory + requested_size;
+                if (end <= a.commit_limit || commit(arena, end)) {
+                    a.current_point   = end;
+                    a.high_water_mark = max(a.high_water_mark, (s64)(end - a.base));
+                    return old_memory;
+                }
+            }
+        } __attribute__ ((fallthrough)); // [[fallthrough]]:
+        case ALLOCATE:   {
+            auto result = get(arena, requested_size);
+            if (mode == REALLOCATE && old_memory && result) {
+                memcpy(result, old_memory, old_size);
+            }
+            return result;
+        }
+        case DEALLOCATE: {
+            // Only the last allocation can be given back, everything else waits for the reset:
+            if (old_size && a.current_point - old_size == (u8*) old_memory) a.current_point = (u8*) old_memory;
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+auto virtual_arena_allocator(Virtual_Arena* arena) -> Allocator {
+    return Allocator{&virtual_arena_allocator_proc, arena};
+}
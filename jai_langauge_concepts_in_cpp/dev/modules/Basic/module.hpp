@@ -80,7 +80,7 @@ auto min(const T& __restrict__ a, const T& __restrict__ b) -> T {
 enum Allocator_Mode {
     ALLOCATE,
     REALLOCATE,
-    DEALLOCATE
+    DEALLOCATE  // old_size is the size it was allocated with when the caller knows it, 0 when it doesn't
 };
 
 using Allocator_Proc = auto(*)(Allocator_Mode mode, s64 requested_size, s64 old_size, void* old_memory, void* allocator_data) -> void*;
@@ -96,8 +96,27 @@ struct Allocator {
 // Forward Declarations:
 auto default_allocator_proc(Allocator_Mode mode, s64 requested_size, s64 old_size, void* old_memory, void* allocator_data) -> void*;
 auto    temp_allocator_proc(Allocator_Mode mode, s64 requested_size, s64 old_size, void* old_memory, void* allocator_data) -> void*;
+auto    heap_allocator_proc(Allocator_Mode mode, s64 requested_size, s64 old_size, void* old_memory, void* allocator_data) -> void*;
+
+CONST_VAR s64 DEFAULT_TEMP_ALLOCATOR_SHRINK_AFTER_CYCLES = 256;
+
+enum class Huge_Pages : u8 {
+    NONE,
+    TRANSPARENT, // madvise(MADV_HUGEPAGE), the kernel backs the pool with 2MB pages when it can
+    EXPLICIT     // MAP_HUGETLB from the reserved pool (vm.nr_hugepages), falls back to TRANSPARENT if there aren't enough
+};
+
+struct Temp_Allocator_Config {
+    Huge_Pages huge_pages = Huge_Pages::NONE;
+    bool       prefault   = false; // fault every page of a pool in when it's mapped, instead of on first touch
+};
+
+// Used by every Temp_Allocator that doesn't point at its own config:
+Temp_Allocator_Config default_temp_allocator_config = {};
 
 struct Temp_Allocator {
+    Temp_Allocator_Config* config = {}; // null uses default_temp_allocator_config
+
     s64 alignment             = 8;
     s64 high_water_mark       = {};
 
@@ -109,6 +128,25 @@ struct Temp_Allocator {
     u8* original_memory_base  = {};
     u8* original_memory_limit = {};
 
+    // Kept across reset_temp_allocator() cycles:
+    u8* dirty_limit           = {}; // pages of the original pool below this may be committed
+    s64 low_usage_cycles      = {};
+    s64 low_usage_peak        = {};
+    s64 shrink_after_cycles   = DEFAULT_TEMP_ALLOCATOR_SHRINK_AFTER_CYCLES; // low usage cycles in a row before decommitting
+    s64 syscalls              = {}; // mmap/munmap/madvise calls made so far
+    s64 page_size             = {}; // of the current pools, 2MB when they are backed by huge pages
+
+    u8* peak_point            = {}; // furthest into the original pool this cycle got before a set_temp_mark()
+
+    // Stats, for sizing the first pool (reserve max_cycle_peak and nothing overflows):
+    s64 cycle_peak            = {}; // most bytes live at once this cycle, high_water_mark only has the current amount
+    s64 cycle_overflows       = {}; // pools chained on this cycle
+    s64 last_cycle_peak       = {}; // the two above for the cycle the last reset_temp_allocator() ended
+    s64 last_cycle_overflows  = {};
+    s64 max_cycle_peak        = {};
+    s64 overflowed_cycles     = {}; // cycles that needed more than one pool
+    s64 cycles                = {};
+
     struct Next_Pool_Footer {
         u8* next_memory_base  = {};
         u8* next_memory_limit = {};
@@ -117,7 +155,11 @@ struct Temp_Allocator {
 
 // Context:
 struct Context {
+#ifdef USE_HEAP_ALLOCATOR
+    CONST_VAR auto default_allocator = Allocator{&heap_allocator_proc,    nullptr}; // see Heap_Allocator.hpp
+#else
     CONST_VAR auto default_allocator = Allocator{&default_allocator_proc, nullptr};
+#endif
     CONST_VAR auto temp_allocator    = Allocator{&temp_allocator_proc,    nullptr};
 
     Allocator      allocator    = default_allocator;
@@ -146,10 +188,12 @@ auto realloc(void* memory, s64 size, s64 old_size) -> void* {
     return result;
 }
 
-void dealloc(void* memory) {
+// Pass the size it was allocated with whenever you have it, allocators can skip looking it up
+// (and the temp allocator can take back its last allocation):
+void dealloc(void* memory, s64 size = 0) {
     auto& a = context.allocator;
 
-    a.proc(DEALLOCATE, 0, 0, memory, a.data);
+    a.proc(DEALLOCATE, 0, size, memory, a.data);
 }
 
 #define push_allocator(new_allocator, ...) {      \
@@ -240,7 +284,11 @@ auto NewArray(s64 count, bool initialized = true) -> Array_View<T> {
     return result;
 }
 
+#include "Trace.hpp"
 #include "Default_Allocator.hpp"
+#include "Heap_Allocator.hpp"
 #include "Temp_Allocator.hpp"
+#include "Virtual_Arena.hpp"
+#include "Pool_Allocator.hpp"
 #include "Array.hpp"
 #include "String.hpp"
@@ -0,0 +1,306 @@
+#pragma once
+
+// Concurrent_Hash_Table: a hash table that any number of threads can look things up in and add to at once,
+// for the shared symbol/ID table kind of thing where a Hash_Table behind one Mutex serializes everybody.
+//
+// Lookups take no lock at all. Writers lock one of CONCURRENT_TABLE_STRIPES stripes, picked by the key's
+// hash, so the same key always goes through the same stripe (no two threads can add it twice) while
+// different keys mostly don't wait on each other. Inside the one shared slot array a writer takes an empty
+// slot by CASing its node in, so writers on different stripes can fill slots right next to each other.
+// Keys and values live in nodes (from a Pool_Allocator per stripe) that never move, so a value pointer
+// stays good until table_deinit. Growing takes every stripe, copies the node pointers into an array twice
+// the size and publishes it. Readers still in the old array are fine, since it's only freed at table_deinit
+// (all the old arrays together are smaller than the current one).
+//
+// Same calls as Hash_Table: table_init, table_deinit, table_add, table_set, table_find_pointer,
+// table_contains, table_find_or_add.
+//
+// NOTE(WALKER): No table_remove, it would need tombstones and a way to know nobody is reading a node anymore.
+//               table_set on a key that's already there writes the value in place, so a thread reading that
+//               value at the same time is racing with it (make the value an ID that's set once, or atomic).
+//               Call table_init from a thread whose context.allocator can be used from any thread (not the
+//               temp allocator), that's where every array and node comes from.
+
+#include "Basic/module.hpp"
+#include "Threads/module.hpp"
+#include "Hashes.hpp"
+
+CONST_VAR s64 CONCURRENT_TABLE_STRIPES = 32; // power of 2, and no more than DEBUG_LOCKS can track held at once
+
+template<typename Key_Type, typename Value_Type>
+struct Concurrent_Hash_Table {
+    CONST_VAR s64 SIZE_MIN            = 64;
+    CONST_VAR s64 LOAD_FACTOR_PERCENT = 70;
+    CONST_VAR s64 NODES_PER_SLAB      = 256;
+
+    struct Node {
+        Key_Type   key   = {};
+        Value_Type value = {};
+    };
+
+    // Taken once its node is set, the hash is only there to skip comparing keys (0 when not stored yet):
+    struct Slot {
+        std::atomic<Node*> node = {};
+        std::atomic<u32>   hash = {};
+    };
+
+    struct Slot_Array {
+        s64         allocated = {};
+        Slot_Array* retired   = {}; // the array this one replaced
+        Slot*       slots     = {};
+    };
+
+    struct Stripe {
+        Adaptive_Mutex mutex   = {};
+        Pool_Allocator nodes   = {};
+
+        u8             padding[CACHE_LINE_SIZE];
+    };
+
+    std::atomic<Slot_Array*> current = {};
+    Allocator                allocator = {};
+
+    u8                       padding_0[CACHE_LINE_SIZE];
+
+    std::atomic<s64>         count   = {}; // counts slots taken (or about to be), so it never goes over the load factor
+
+    u8                       padding_1[CACHE_LINE_SIZE];
+
+    Stripe                   stripes[CONCURRENT_TABLE_STRIPES];
+};
+
+template<typename Key_Type, typename Value_Type>
+auto concurrent_table_allocate(Concurrent_Hash_Table<Key_Type, Value_Type>* table, s64 slots_to_allocate) -> typename Concurrent_Hash_Table<Key_Type, Value_Type>::Slot_Array* {
+    auto& t = *table;
+
+    using Slot_Array = typename Concurrent_Hash_Table<Key_Type, Value_Type>::Slot_Array;
+    using Slot       = typename Concurrent_Hash_Table<Key_Type, Value_Type>::Slot;
+
+    auto n = next_pow2(max(slots_to_allocate, t.SIZE_MIN));
+
+    Slot_Array* array = {};
+    push_allocator(t.allocator, array = (Slot_Array*) alloc((s64) sizeof(Slot_Array) + n * (s64) sizeof(Slot));)
+
+    new (array) Slot_Array;
+    array->allocated = n;
+    array->slots     = (Slot*)(array + 1);
+    for (s64 i = 0; i < n; ++i) new (&array->slots[i]) Slot;
+
+    return array;
+}
+
+template<typename Key_Type, typename Value_Type>
+void table_init(Concurrent_Hash_Table<Key_Type, Value_Type>* table, s64 slots_to_allocate = 0) {
+    auto& t = *table;
+
+    using Node = typename Concurrent_Hash_Table<Key_Type, Value_Type>::Node;
+
+    remember_allocators(table);
+
+    for (auto& stripe : t.stripes) {
+        init(&stripe.mutex, "Concurrent_Hash_Table stripe");
+        push_allocator(t.allocator, init(&stripe.nodes, sizeof(Node), t.NODES_PER_SLAB, alignof(Node));)
+    }
+
+    t.count.store(0, std::memory_order_relaxed);
+    t.current.store(concurrent_table_allocate(table, slots_to_allocate), std::memory_order_release);
+}
+
+// Nobody can be using it anymore by now:
+template<typename Key_Type, typename Value_Type>
+void table_deinit(Concurrent_Hash_Table<Key_Type, Value_Type>* table) {
+    auto& t = *table;
+
+    using Slot_Array = typename Concurrent_Hash_Table<Key_Type, Value_Type>::Slot_Array;
+    using Slot       = typename Concurrent_Hash_Table<Key_Type, Value_Type>::Slot;
+
+    auto array = t.current.load(std::memory_order_acquire);
+    while (array) {
+        auto retired = array->retired;
+        push_allocator(t.allocator, dealloc(array, (s64) sizeof(Slot_Array) + array->allocated * (s64) sizeof(Slot));)
+        array = retired;
+    }
+
+    for (auto& stripe : t.stripes) {
+        deinit(&stripe.nodes);
+        destroy(&stripe.mutex);
+    }
+
+    t.current.store(nullptr, std::memory_order_relaxed);
+    t.count.store(0, std::memory_order_relaxed);
+}
+
+// Doubles "seen", unless somebody else already replaced it while we were waiting for the stripes:
+template<typename Key_Type, typename Value_Type>
+void concurrent_table_grow(Concurrent_Hash_Table<Key_Type, Value_Type>* table, typename Concurrent_Hash_Table<Key_Type, Value_Type>::Slot_Array* seen) {
+    auto& t = *table;
+
+    for (auto& stripe : t.stripes) lock(&stripe.mutex);
+    defer { for (auto& stripe : t.stripes) unlock(&stripe.mutex); };
+
+    if (t.current.load(std::memory_order_relaxed) != seen) return;
+
+    auto array = concurrent_table_allocate(table, seen->allocated * 2);
+    auto mask  = (u64)(array->allocated - 1);
+
+    // With every stripe held nothing else writes, and readers can't see the new array yet:
+    for (s64 i = 0; i < seen->allocated; ++i) {
+        auto& old_slot = seen->slots[i];
+
+        auto node = old_slot.node.load(std::memory_order_relaxed);
+        if (!node) continue;
+
+        auto hash            = old_slot.hash.load(std::memory_order_relaxed);
+        auto index           = hash & mask;
+        u64  probe_increment = 1;
+
+        while (array->slots[index].node.load(std::memory_order_relaxed)) {
+            index            = (index + probe_increment) & mask;
+            probe_increment += 1;
+        }
+
+        array->slots[index].node.store(node, std::memory_order_relaxed);
+        array->slots[index].hash.store(hash, std::memory_order_relaxed);
+    }
+
+    array->retired = seen;
+    t.current.store(array, std::memory_order_release);
+}
+
+enum Concurrent_Table_Write {
+    CONCURRENT_TABLE_ADD,         // don't look, just add
+    CONCURRENT_TABLE_SET,         // overwrite the value if it's there
+    CONCURRENT_TABLE_FIND_OR_ADD, // leave the value alone if it's there
+};
+
+// Everything that writes comes through here, returns the value of the key (newly added or not):
+template<typename Key_Type, typename Value_Type>
+auto concurrent_table_write(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, Arg<Value_Type> value, Concurrent_Table_Write mode, bool* newly_added) -> Value_Type* {
+    auto& t = *table;
+
+    using Node = typename Concurrent_Hash_Table<Key_Type, Value_Type>::Node;
+
+    auto  hash   = get_hash(key);
+    auto& stripe = t.stripes[(hash >> 16) & (CONCURRENT_TABLE_STRIPES - 1)];
+
+    Node* node = {}; // ours, made once we get to an empty slot
+
+    lock(&stripe.mutex);
+
+    while (true) {
+        auto array           = t.current.load(std::memory_order_acquire);
+        auto mask            = (u64)(array->allocated - 1);
+        auto index           = hash & mask;
+        u64  probe_increment = 1;
+        bool counted         = false;
+
+        while (true) {
+            auto& slot     = array->slots[index];
+            auto  existing = slot.node.load(std::memory_order_acquire);
+
+            if (!existing) {
+                // Count it before taking the slot, so however many threads get here there's always an empty slot left:
+                if (!counted) {
+                    if ((t.count.fetch_add(1, std::memory_order_relaxed) + 1) * 100 > array->allocated * t.LOAD_FACTOR_PERCENT) {
+                        t.count.fetch_sub(1, std::memory_order_relaxed);
+                        break;
+                    }
+                    counted = true;
+                }
+
+                if (!node) {
+                    node = (Node*) get(&stripe.nodes);
+                    new (node) Node;
+                    node->key   = key;
+                    node->value = value;
+                }
+
+                // Release, so whoever sees the node sees its key and value:
+                if (slot.node.compare_exchange_strong(existing, node, std::memory_order_release, std::memory_order_acquire)) {
+                    slot.hash.store(hash, std::memory_order_relaxed);
+                    unlock(&stripe.mutex);
+
+                    if (newly_added) *newly_added = true;
+                    return &node->value;
+                }
+
+                // A writer on another stripe got it first, "existing" is theirs now.
+            }
+
+            if (mode != CONCURRENT_TABLE_ADD) {
+                auto slot_hash = slot.hash.load(std::memory_order_relaxed);
+                if ((slot_hash == hash || !slot_hash) && existing->key == key) {
+                    if (mode == CONCURRENT_TABLE_SET) existing->value = value;
+
+                    // Only if the key got added on another stripe, which can't happen, but keep the count right:
+                    if (counted) t.count.fetch_sub(1, std::memory_order_relaxed);
+                    if (node)    release(&stripe.nodes, node);
+                    unlock(&stripe.mutex);
+
+                    if (newly_added) *newly_added = false;
+                    return &existing->value;
+                }
+            }
+
+            index            = (index + probe_increment) & mask;
+            probe_increment += 1;
+        }
+
+        // Full, grow it (that takes every stripe, ours too) and walk the new array:
+        unlock(&stripe.mutex);
+        concurrent_table_grow(table, array);
+        lock(&stripe.mutex);
+    }
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_find_pointer(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key) -> Value_Type* {
+    auto& t = *table;
+
+    auto array           = t.current.load(std::memory_order_acquire);
+    auto mask            = (u64)(array->allocated - 1);
+    auto hash            = get_hash(key);
+    auto index           = hash & mask;
+    u64  probe_increment = 1;
+
+    while (true) {
+        auto& slot = array->slots[index];
+
+        auto node = slot.node.load(std::memory_order_acquire);
+        if (!node) return nullptr;
+
+        auto slot_hash = slot.hash.load(std::memory_order_relaxed);
+        if ((slot_hash == hash || !slot_hash) && node->key == key) return &node->value;
+
+        index            = (index + probe_increment) & mask;
+        probe_increment += 1;
+    }
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_contains(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key) -> bool {
+    return table_find_pointer(table, key) != nullptr;
+}
+
+// Adds without looking for the key first (like Hash_Table's table_add, duplicates are on you):
+template<typename Key_Type, typename Value_Type>
+auto table_add(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type* {
+    return concurrent_table_write(table, key, value, CONCURRENT_TABLE_ADD, nullptr);
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_set(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type* {
+    return concurrent_table_write(table, key, value, CONCURRENT_TABLE_SET, nullptr);
+}
+
+// Returns the key's value, adding it with "value" when it isn't there yet. The value goes in before anybody
+// can see the key, so this is the one to use when several threads may race to add the same key:
+template<typename Key_Type, typename Value_Type>
+auto table_find_or_add(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, Arg<Value_Type> value, bool* newly_added = nullptr) -> Value_Type* {
+    return concurrent_table_write(table, key, value, CONCURRENT_TABLE_FIND_OR_ADD, newly_added);
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_find_or_add(Concurrent_Hash_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, bool* newly_added = nullptr) -> Value_Type* {
+    return concurrent_table_write(table, key, Value_Type{}, CONCURRENT_TABLE_FIND_OR_ADD, newly_added);
+}
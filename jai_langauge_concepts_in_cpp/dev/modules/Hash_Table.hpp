@@ -14,6 +14,7 @@ struct Hash_Table {
     CONST_VAR u32  LOAD_FACTOR_PERCENT = Load_Factor_Percent;
     CONST_VAR bool REFILL_REMOVED      = Refill_Removed;
     CONST_VAR s64  SIZE_MIN            = 32;
+    CONST_VAR s64  REMOVED_MAX_PERCENT = 20; // table_remove() rehashes in place once this many slots are tombstones
 
     s64 count            = {};
 
@@ -70,6 +71,62 @@ void table_resize(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_R
 template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
 auto table_add(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type*;
 
+// Drops every tombstone without allocating a new entries array: entries get moved to the first slot of their
+// walk that isn't taken by an entry already placed, swapping with not yet placed ones on the way
+// (the bit array of placed entries comes from the temp allocator).
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void table_rehash_in_place(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    auto& t = *table;
+
+    auto mask = (u32)(t.allocated - 1);
+
+    push_temp_mark(
+        Array_View<u64> placed;
+        push_allocator(context.temp_allocator, placed = NewArray<u64>((t.allocated + 63) / 64, false);)
+        memset(placed.data, 0, (u64) placed.count * sizeof(u64));
+
+        auto is_placed  = [&](u32 index) { return (placed[index / 64] >> (index % 64)) & 1; };
+        auto set_placed = [&](u32 index) { placed[index / 64] |= (u64) 1 << (index % 64); };
+
+        for (auto& entry : t.entries) {
+            if (entry.hash == REMOVED_HASH) entry.hash = NEVER_OCCUPIED_HASH;
+        }
+
+        for (u32 i = 0; i <= mask; ++i) {
+            while (t.entries[i].hash >= FIRST_VALID_HASH && !is_placed(i)) {
+                auto hash            = t.entries[i].hash;
+                auto index           = hash & mask;
+                u32  probe_increment = 1;
+
+                while (is_placed(index)) {
+                    index            = (index + probe_increment) & mask;
+                    probe_increment += 1;
+                }
+
+                // Already where it belongs:
+                if (index == i) {
+                    set_placed(i);
+                    break;
+                }
+
+                set_placed(index);
+
+                // Into an empty slot, or swap with an unplaced entry and go again with that one:
+                if (t.entries[index].hash == NEVER_OCCUPIED_HASH) {
+                    t.entries[index]      = t.entries[i];
+                    t.entries[i].hash     = NEVER_OCCUPIED_HASH;
+                } else {
+                    auto moving           = t.entries[index];
+                    t.entries[index]      = t.entries[i];
+                    t.entries[i]          = moving;
+                }
+            }
+        }
+    )
+
+    t.slots_filled = t.count;
+}
+
 template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
 void table_expand(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
     auto& t = *table;
@@ -86,6 +143,12 @@ void table_expand(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_R
 
     if (new_allocated < t.SIZE_MIN) new_allocated = t.SIZE_MIN;
 
+    // Mostly tombstones, it's the same size either way:
+    if (new_allocated == t.allocated) {
+        table_rehash_in_place(table);
+        return;
+    }
+
     table_resize(table, new_allocated);
 
     t.count        = 0;
@@ -95,7 +158,7 @@ void table_expand(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_R
         if (entry.hash >= FIRST_VALID_HASH) table_add(table, entry.key, entry.value);
     }
 
-    push_allocator(t.allocator, dealloc(old_entries.data);)
+    push_allocator(t.allocator, dealloc(old_entries.data, old_entries.count * (s64) sizeof(old_entries[0]));)
 }
 
 template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
@@ -112,7 +175,7 @@ void table_init(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Rem
 
 template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
 void table_deinit(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
-    push_allocator(table->allocator, dealloc(table->entries.data);)
+    push_allocator(table->allocator, dealloc(table->entries.data, table->entries.count * (s64) sizeof(table->entries[0]));)
 }
 
 template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
@@ -161,7 +224,7 @@ auto table_find_pointer(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Re
     if (!t.allocated) return nullptr;
 
     Walk_Table(
-        auto& entry = t.entries[hash];
+        auto& entry = t.entries[index];
         if ((entry.hash == hash) && (entry.key == key)) {
             return &entry.value;
         }
@@ -211,8 +274,63 @@ auto table_find_multiple(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, R
 
 // TODO(WALKER): multi-return value stuff, figure it out at some point
 
-// template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
-// void table_remove(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key) {}
+// Returns whether the key was there, its value goes into "removed_value" if given.
+// The slot becomes a tombstone (walks for other keys may go through it), too many of those and we rehash:
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_remove(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, Value_Type* removed_value = nullptr) -> bool {
+    auto& t = *table;
+    if (!t.allocated) return false;
 
-// template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
-// void table_find_or_add(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key) {}
+    Walk_Table(
+        auto& entry = t.entries[index];
+        if ((entry.hash == hash) && (entry.key == key)) {
+            if (removed_value) *removed_value = entry.value;
+
+            entry.hash = REMOVED_HASH;
+            t.count   -= 1;
+
+            if ((t.slots_filled - t.count) * 100 > t.allocated * t.REMOVED_MAX_PERCENT) table_rehash_in_place(table);
+            return true;
+        }
+    )
+
+    return false;
+}
+
+// One walk for both: returns the key's value, adding it (value initialized) when it isn't there yet.
+// "newly_added", if given, says which one happened.
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_find_or_add(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, bool* newly_added = nullptr) -> Value_Type* {
+    auto& t = *table;
+
+    // Make room up front, growing after the walk would move the slot we found:
+    if (((t.slots_filled + 1) * 100) > (t.allocated * t.LOAD_FACTOR_PERCENT)) table_expand(table);
+
+    s64 first_removed = -1;
+
+    Walk_Table(
+        auto& entry = t.entries[index];
+        if ((entry.hash == hash) && (entry.key == key)) {
+            if (newly_added) *newly_added = false;
+            return &entry.value;
+        }
+        if (t.REFILL_REMOVED && first_removed < 0 && entry.hash == REMOVED_HASH) first_removed = index;
+    )
+
+    // Not there, "index" is the empty slot that ended the walk:
+    if (first_removed >= 0) {
+        index           = (u32) first_removed;
+        t.slots_filled -= 1;
+    }
+
+    t.count        += 1;
+    t.slots_filled += 1;
+
+    auto& entry = t.entries[index];
+    entry.hash  = hash;
+    entry.key   = key;
+    entry.value = Value_Type{};
+
+    if (newly_added) *newly_added = true;
+    return &entry.value;
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+// Incremental_Hash_Table: a Hash_Table that never stops to rehash everything at once.
+// When the table it fills up needs to grow (or get rid of its tombstones) it becomes "old", the next entries
+// array takes its place, and every add/set/remove/find_or_add after that moves the next MIGRATE_SLOTS slots
+// of the old array over. Lookups check both arrays until the old one is empty.
+// The next array is allocated half way to the resize and cleared (which is also what page faults it in)
+// MIGRATE_SLOTS slots per call until then, so the worst case of an insert is MIGRATE_SLOTS re-adds instead of
+// touching every slot of a table twice the size.
+//
+// Same calls as Hash_Table: table_init, table_deinit, table_reset, table_add, table_set, table_find_pointer,
+// table_contains, table_remove, table_find_or_add, plus table_finish_resize to get it over with.
+//
+// NOTE(WALKER): Value pointers into the old array go stale when their entry moves (any add/set/remove),
+//               same rule as pointers into a Hash_Table across a table_add. To walk every entry go over both
+//               t.table.entries and t.old.entries.
+
+#include "Basic/module.hpp"
+#include "Hash_Table.hpp"
+
+template<typename Key_Type, typename Value_Type,
+         u32  Load_Factor_Percent = 70,
+         bool Refill_Removed      = true>
+struct Incremental_Hash_Table {
+    CONST_VAR s64 MIGRATE_SLOTS = 64; // old slots moved over per modifying call
+
+    s64 count         = {};
+
+    Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed> table = {}; // new entries go here
+    Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed> old   = {}; // allocated only while resizing
+
+    s64 migrate_index = {}; // old slots before this one are moved already
+
+    // The array the next resize moves into, allocated once we are half way there and cleared a bit per call,
+    // so the resize itself doesn't have to touch all of it at once:
+    Array_View<typename Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>::Entry> next = {};
+    s64 next_cleared  = {};
+};
+
+// Like table_remove but never rehashes, the old array can't be moved around under migrate_index:
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto incremental_table_tombstone(Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, Value_Type* removed_value) -> bool {
+    auto& t = *table;
+    if (!t.allocated) return false;
+
+    Walk_Table(
+        auto& entry = t.entries[index];
+        if ((entry.hash == hash) && (entry.key == key)) {
+            if (removed_value) *removed_value = entry.value;
+
+            entry.hash = REMOVED_HASH;
+            t.count   -= 1;
+            return true;
+        }
+    )
+
+    return false;
+}
+
+// Allocates the array the next resize moves into, it gets cleared a bit at a time from here on:
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void incremental_table_allocate_next(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, s64 slots_to_allocate) {
+    auto& t = *table;
+
+    using Entry = typename Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>::Entry;
+
+    push_allocator(t.table.allocator, t.next = NewArray<Entry>(next_pow2(slots_to_allocate), false);)
+    t.next_cleared = 0;
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void incremental_table_clear_next(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, s64 slots) {
+    auto& t = *table;
+
+    auto end = min(t.next_cleared + slots, t.next.count);
+    for (; t.next_cleared < end; ++t.next_cleared) {
+        t.next[t.next_cleared].hash = NEVER_OCCUPIED_HASH;
+    }
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void incremental_table_migrate(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, s64 slots) {
+    auto& t = *table;
+    if (!t.old.allocated) return;
+
+    auto end = min(t.migrate_index + slots, t.old.allocated);
+    for (; t.migrate_index < end; ++t.migrate_index) {
+        auto& entry = t.old.entries[t.migrate_index];
+        if (entry.hash < FIRST_VALID_HASH) continue;
+
+        table_add(&t.table, entry.key, entry.value);
+        entry.hash   = REMOVED_HASH;
+        t.old.count -= 1;
+    }
+
+    // All moved (or the rest were tombstones anyway):
+    if (t.migrate_index == t.old.allocated || !t.old.count) {
+        push_allocator(t.old.allocator, dealloc(t.old.entries.data, t.old.entries.count * (s64) sizeof(t.old.entries[0]));)
+
+        t.old.entries      = {};
+        t.old.allocated    = 0;
+        t.old.count        = 0;
+        t.old.slots_filled = 0;
+        t.migrate_index    = 0;
+    }
+}
+
+// The bounded bit of work every modifying call does: move entries over, or else get the next array ready.
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void incremental_table_step(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    auto& t = *table;
+
+    if (t.old.allocated) incremental_table_migrate(table, t.MIGRATE_SLOTS);
+    else                 incremental_table_clear_next(table, t.MIGRATE_SLOTS);
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void table_finish_resize(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    incremental_table_migrate(table, table->old.allocated);
+}
+
+// Makes the next array the one we add to and starts moving the current one over. Normally the next array
+// is cleared by now and has room for what's live plus what gets added before the migration is done,
+// when it isn't (lots of removes and adds shifting things around) we pay for it here.
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void incremental_table_start_resize(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    auto& t = *table;
+    auto& c = t.table;
+
+    if (t.old.allocated) table_finish_resize(table);
+
+    auto needed = (c.count + c.allocated / t.MIGRATE_SLOTS + 1) * 100;
+    if (t.next.count && needed > t.next.count * c.LOAD_FACTOR_PERCENT) {
+        push_allocator(c.allocator, dealloc(t.next.data, t.next.count * (s64) sizeof(t.next[0]));)
+        t.next = {};
+    }
+
+    if (!t.next.count) {
+        // Same sizing as table_expand: double, unless it's mostly tombstones filling it up.
+        if (((c.count * 2 + 1) * 100) < (c.allocated * c.LOAD_FACTOR_PERCENT)) incremental_table_allocate_next(table, c.allocated);
+        else                                                                   incremental_table_allocate_next(table, c.allocated * 2);
+    }
+    incremental_table_clear_next(table, t.next.count);
+
+    t.old           = c;
+    t.migrate_index = 0;
+
+    c.entries      = t.next;
+    c.allocated    = t.next.count;
+    c.count        = 0;
+    c.slots_filled = 0;
+
+    t.next         = {};
+    t.next_cleared = 0;
+}
+
+// Before anything goes into t.table: make sure its own table_add won't expand it, then do a step.
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void incremental_table_prepare_add(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    auto& t = *table;
+    auto& c = t.table;
+
+    if (!c.allocated) table_init(table);
+
+    // Half way to growing, the next array gets cleared from now on (mostly tombstones means it stays this size):
+    if (!t.old.allocated && !t.next.count && (c.slots_filled * 200) >= (c.allocated * c.LOAD_FACTOR_PERCENT)) {
+        auto tombstones = c.slots_filled - c.count;
+        incremental_table_allocate_next(table, tombstones * 2 > c.slots_filled ? c.allocated : c.allocated * 2);
+    }
+
+    // Room for this add and the ones migrate is about to do:
+    auto slots = t.old.allocated ? t.MIGRATE_SLOTS : 0;
+    if (((c.slots_filled + slots + 1) * 100) > (c.allocated * c.LOAD_FACTOR_PERCENT)) incremental_table_start_resize(table);
+
+    incremental_table_step(table);
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void table_init(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, s64 slots_to_allocate = 0) {
+    auto& t = *table;
+
+    table_init(&t.table, slots_to_allocate);
+    t.old.allocator = t.table.allocator;
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void table_deinit(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    auto& t = *table;
+
+    table_deinit(&t.table);
+    if (t.old.allocated) table_deinit(&t.old);
+    if (t.next.count) push_allocator(t.table.allocator, dealloc(t.next.data, t.next.count * (s64) sizeof(t.next[0]));)
+
+    t = {};
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+void table_reset(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table) {
+    auto& t = *table;
+
+    if (t.old.allocated) {
+        t.migrate_index = t.old.allocated;
+        t.old.count     = 0;
+        incremental_table_migrate(table, 0);
+    }
+
+    table_reset(&t.table);
+    t.count = 0;
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_find_pointer(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key) -> Value_Type* {
+    auto& t = *table;
+
+    auto value_ptr = table_find_pointer(&t.table, key);
+    if (!value_ptr && t.old.count) value_ptr = table_find_pointer(&t.old, key);
+
+    return value_ptr;
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_contains(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key) -> bool {
+    return table_find_pointer(table, key) != nullptr;
+}
+
+// Adds without looking for the key first (like Hash_Table's table_add, duplicates are on you):
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_add(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type* {
+    auto& t = *table;
+
+    incremental_table_prepare_add(table);
+
+    auto value_ptr = table_add(&t.table, key, value);
+    t.count        = t.table.count + t.old.count;
+
+    return value_ptr;
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_set(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type* {
+    auto& t = *table;
+
+    // Migrate first, the pointer we find has to survive until we return it:
+    incremental_table_prepare_add(table);
+
+    auto value_ptr = table_find_pointer(table, key);
+    if (value_ptr) {
+        *value_ptr = value;
+        return value_ptr;
+    }
+
+    value_ptr = table_add(&t.table, key, value);
+    t.count   = t.table.count + t.old.count;
+
+    return value_ptr;
+}
+
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_find_or_add(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, bool* newly_added = nullptr) -> Value_Type* {
+    auto& t = *table;
+
+    incremental_table_prepare_add(table);
+
+    if (t.old.count) {
+        auto value_ptr = table_find_pointer(&t.old, key);
+        if (value_ptr) {
+            if (newly_added) *newly_added = false;
+            return value_ptr;
+        }
+    }
+
+    auto value_ptr = table_find_or_add(&t.table, key, newly_added);
+    t.count        = t.table.count + t.old.count;
+
+    return value_ptr;
+}
+
+// Tombstones piling up in t.table start a (same size) incremental resize instead of Hash_Table's in place rehash:
+template<typename Key_Type, typename Value_Type, u32 Load_Factor_Percent, bool Refill_Removed>
+auto table_remove(Incremental_Hash_Table<Key_Type, Value_Type, Load_Factor_Percent, Refill_Removed>* table, Arg<Key_Type> key, Value_Type* removed_value = nullptr) -> bool {
+    auto& t = *table;
+    auto& c = t.table;
+
+    incremental_table_step(table);
+
+    auto removed = incremental_table_tombstone(&c, key, removed_value);
+    if (!removed && t.old.count) removed = incremental_table_tombstone(&t.old, key, removed_value);
+    if (!removed) return false;
+
+    t.count = c.count + t.old.count;
+
+    // Once the next array is ready (cleared by the steps above), otherwise get it going:
+    if (!t.old.allocated && (c.slots_filled - c.count) * 100 > c.allocated * c.REMOVED_MAX_PERCENT) {
+        if (!t.next.count)                         incremental_table_allocate_next(table, c.allocated);
+        else if (t.next_cleared == t.next.count)   incremental_table_start_resize(table);
+    }
+
+    return true;
+}
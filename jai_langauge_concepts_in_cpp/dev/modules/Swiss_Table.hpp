@@ -0,0 +1,256 @@
+#pragma once
+
+// Swiss_Table: open addressing like Hash_Table, but the probing happens in a separate array of one control
+// byte per slot instead of in the entries. A control byte is either SWISS_EMPTY, SWISS_DELETED, or (for a
+// full slot) the low 7 bits of the key's hash. A probe loads 16 control bytes at once and compares all of
+// them against the tag with SSE2, so a lookup usually touches one cache line of control bytes and then
+// exactly the one slot whose tag matched. Keys and values sit together in a dense slot array.
+// Targets without SSE2 get the same group compare as a plain byte loop.
+//
+// Same calls as Hash_Table: table_init, table_deinit, table_reset, table_add, table_set, table_find_pointer,
+// table_contains, plus table_remove.
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Basic/module.hpp"
+#include "Hashes.hpp"
+
+CONST_VAR s8  SWISS_EMPTY      = -128; // 0b1000'0000
+CONST_VAR s8  SWISS_DELETED    = -2;   // 0b1111'1110, a full slot has the top bit clear
+CONST_VAR s64 SWISS_GROUP_SIZE = 16;
+
+template<typename Key_Type, typename Value_Type>
+struct Swiss_Table {
+    CONST_VAR s64 SIZE_MIN             = SWISS_GROUP_SIZE;
+    CONST_VAR s64 MAX_LOAD_NUMERATOR   = 7; // 7/8ths full before growing, groups of 16 keep that cheap to probe
+    CONST_VAR s64 MAX_LOAD_DENOMINATOR = 8;
+
+    s64 count          = {};
+
+    s64 allocated      = {};
+    s64 growth_left    = {}; // empty slots we can still fill before growing (deleted ones don't count)
+
+    Allocator allocator = {};
+
+    struct Slot {
+        Key_Type   key   = {};
+        Value_Type value = {};
+    };
+
+    s8*   control = {};
+    Slot* slots   = {};
+};
+
+#if defined(__SSE2__)
+// Bit i is set for every byte i of the group equal to "tag":
+auto swiss_match(const s8* group, s8 tag) -> u32 {
+    auto bytes = _mm_loadu_si128((const __m128i*) group);
+    return (u32) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag)));
+}
+
+// Empty or deleted are the only control bytes with the top bit set:
+auto swiss_match_empty_or_deleted(const s8* group) -> u32 {
+    return (u32) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+}
+#else
+// Same masks one byte at a time (the compiler is free to vectorize these for whatever the target has):
+auto swiss_match(const s8* group, s8 tag) -> u32 {
+    u32 result = 0;
+    for (s64 i = 0; i < SWISS_GROUP_SIZE; ++i) result |= (u32)(group[i] == tag) << i;
+    return result;
+}
+
+auto swiss_match_empty_or_deleted(const s8* group) -> u32 {
+    u32 result = 0;
+    for (s64 i = 0; i < SWISS_GROUP_SIZE; ++i) result |= (u32)(group[i] < 0) << i;
+    return result;
+}
+#endif
+
+// The hash picks the first group to look at (h1) and the 7 bit tag (h2):
+#define Walk_Swiss_Table(...)                                            \
+auto hash        = get_hash(key);                                        \
+auto tag         = (s8)(hash & 0x7F);                                    \
+auto group_mask  = (u64)(t.allocated / SWISS_GROUP_SIZE - 1);            \
+auto group_index = (u64)(hash >> 7) & group_mask;                        \
+                                                                         \
+for (u64 probe_increment = 1; true; ++probe_increment) {                 \
+    auto group = t.control + group_index * SWISS_GROUP_SIZE;             \
+    { __VA_ARGS__ }                                                      \
+    group_index = (group_index + probe_increment) & group_mask;          \
+}
+
+template<typename Key_Type, typename Value_Type>
+void table_resize(Swiss_Table<Key_Type, Value_Type>* table, s64 slots_to_allocate = 0) {
+    auto& t = *table;
+
+    using Slot = typename Swiss_Table<Key_Type, Value_Type>::Slot;
+
+    auto old_control   = t.control;
+    auto old_slots     = t.slots;
+    auto old_allocated = t.allocated;
+
+    if (slots_to_allocate < t.SIZE_MIN) slots_to_allocate = t.SIZE_MIN;
+    auto n = next_pow2(slots_to_allocate);
+
+    // One block, slots first (they want the alignment), control bytes after:
+    push_allocator(t.allocator,
+        t.slots = (Slot*) alloc(n * (s64) sizeof(Slot) + n);
+    )
+    t.control     = (s8*)(t.slots + n);
+    t.allocated   = n;
+    t.count       = 0;
+    t.growth_left = n * t.MAX_LOAD_NUMERATOR / t.MAX_LOAD_DENOMINATOR;
+
+    memset(t.control, SWISS_EMPTY, (u64) n);
+    for (s64 i = 0; i < n; ++i) new (&t.slots[i]) Slot;
+
+    if (!old_slots) return;
+
+    // Nothing in the new table can match, so every entry just goes into the first free slot of its walk:
+    for (s64 i = 0; i < old_allocated; ++i) {
+        if (old_control[i] < 0) continue;
+
+        auto& key = old_slots[i].key;
+        Walk_Swiss_Table(
+            auto free_slots = swiss_match_empty_or_deleted(group);
+            if (free_slots) {
+                auto index       = group_index * SWISS_GROUP_SIZE + (u64) __builtin_ctz(free_slots);
+                t.control[index] = tag;
+                t.slots[index]   = old_slots[i];
+                break;
+            }
+        )
+        t.count       += 1;
+        t.growth_left -= 1;
+    }
+
+    push_allocator(t.allocator, dealloc(old_slots, old_allocated * (s64) sizeof(Slot) + old_allocated);)
+}
+
+template<typename Key_Type, typename Value_Type>
+void table_init(Swiss_Table<Key_Type, Value_Type>* table, s64 slots_to_allocate = 0) {
+    remember_allocators(table);
+    table_resize(table, slots_to_allocate);
+}
+
+template<typename Key_Type, typename Value_Type>
+void table_deinit(Swiss_Table<Key_Type, Value_Type>* table) {
+    auto& t = *table;
+
+    using Slot = typename Swiss_Table<Key_Type, Value_Type>::Slot;
+
+    push_allocator(t.allocator, dealloc(t.slots, t.allocated * (s64) sizeof(Slot) + t.allocated);)
+
+    t.slots       = {};
+    t.control     = {};
+    t.allocated   = {};
+    t.count       = {};
+    t.growth_left = {};
+}
+
+template<typename Key_Type, typename Value_Type>
+void table_reset(Swiss_Table<Key_Type, Value_Type>* table) {
+    auto& t = *table;
+
+    t.count       = 0;
+    t.growth_left = t.allocated * t.MAX_LOAD_NUMERATOR / t.MAX_LOAD_DENOMINATOR;
+    memset(t.control, SWISS_EMPTY, (u64) t.allocated);
+}
+
+// Adds without looking for the key first (like Hash_Table's table_add, duplicates are on you):
+template<typename Key_Type, typename Value_Type>
+auto table_add(Swiss_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type* {
+    auto& t = *table;
+
+    if (!t.allocated) table_init(table);
+
+    // Out of empty slots, grow (or just clean out the deleted ones when they are what's using up the room):
+    if (t.growth_left <= 0) {
+        auto max_load = t.allocated * t.MAX_LOAD_NUMERATOR / t.MAX_LOAD_DENOMINATOR;
+        table_resize(table, t.count * 2 < max_load ? t.allocated : t.allocated * 2);
+    }
+
+    Walk_Swiss_Table(
+        auto free_slots = swiss_match_empty_or_deleted(group);
+        if (free_slots) {
+            auto index = group_index * SWISS_GROUP_SIZE + (u64) __builtin_ctz(free_slots);
+
+            if (t.control[index] == SWISS_EMPTY) t.growth_left -= 1;
+            t.control[index]     = tag;
+            t.slots[index].key   = key;
+            t.slots[index].value = value;
+            t.count             += 1;
+
+            return &t.slots[index].value;
+        }
+    )
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_find_pointer(Swiss_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key) -> Value_Type* {
+    auto& t = *table;
+    if (!t.allocated) return nullptr;
+
+    Walk_Swiss_Table(
+        auto matches = swiss_match(group, tag);
+        while (matches) {
+            auto& slot = t.slots[group_index * SWISS_GROUP_SIZE + (u64) __builtin_ctz(matches)];
+            if (slot.key == key) return &slot.value;
+            matches &= matches - 1;
+        }
+
+        // An empty slot ends the walk, the key would have gone there:
+        if (swiss_match(group, SWISS_EMPTY)) return nullptr;
+    )
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_set(Swiss_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key, Arg<Value_Type> value) -> Value_Type* {
+    auto value_ptr = table_find_pointer(table, key);
+    if (value_ptr) {
+        *value_ptr = value;
+        return value_ptr;
+    }
+
+    return table_add(table, key, value);
+}
+
+template<typename Key_Type, typename Value_Type>
+auto table_contains(Swiss_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key) -> bool {
+    return table_find_pointer(table, key) != nullptr;
+}
+
+// Returns whether it was there. A slot whose group never filled up can go straight back to empty,
+// otherwise some other key's walk may have gone past it and it has to stay a tombstone:
+template<typename Key_Type, typename Value_Type>
+auto table_remove(Swiss_Table<Key_Type, Value_Type>* table, Arg<Key_Type> key) -> bool {
+    auto& t = *table;
+    if (!t.allocated) return false;
+
+    using Slot = typename Swiss_Table<Key_Type, Value_Type>::Slot;
+
+    Walk_Swiss_Table(
+        auto matches = swiss_match(group, tag);
+        while (matches) {
+            auto index = group_index * SWISS_GROUP_SIZE + (u64) __builtin_ctz(matches);
+            if (t.slots[index].key == key) {
+                if (swiss_match(group, SWISS_EMPTY)) {
+                    t.control[index]  = SWISS_EMPTY;
+                    t.growth_left    += 1;
+                } else {
+                    t.control[index]  = SWISS_DELETED;
+                }
+
+                t.slots[index] = Slot{};
+                t.count       -= 1;
+                return true;
+            }
+            matches &= matches - 1;
+        }
+
+        if (swiss_match(group, SWISS_EMPTY)) return false;
+    )
+}
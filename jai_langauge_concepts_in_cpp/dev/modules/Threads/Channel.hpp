@@ -0,0 +1,290 @@
+// Bounded channels for handing items between threads (pipeline stages and the like).
+//
+// SPSC_Channel: exactly one sending thread and one receiving thread.
+// MPMC_Channel: any number of both (Vyukov's bounded queue, a sequence number per cell).
+//
+// Both are a fixed size ring buffer allocated at init() with the remembered allocator, no allocation
+// or lock per item. Head and tail live on their own cache lines. try_send()/try_receive() never block,
+// send()/receive() spin for a bit and then sleep on a futex until the other side makes room/an item
+// (or the timeout runs out). A side that nobody is sleeping on is never woken, so no syscall then.
+
+// One side of a channel that threads can sleep on ("not empty" or "not full").
+// "sequence" is bumped on every wake, so a waiter that read it before the wake can't sleep through it.
+// A wake takes every registered waiter off of "waiting" at once, so while they are still on their way
+// back the other side keeps going without making a syscall per item.
+struct Channel_Waiters {
+    std::atomic<u32> sequence = {};
+    std::atomic<u32> waiting  = {};
+};
+
+// Call after publishing an item/a free slot.
+// NOTE(WALKER): The fence pairs with the waiter's seq_cst increment of "waiting" before it re-checks the
+//               channel, so either we see the waiter or the waiter sees what we just published.
+void channel_notify(Channel_Waiters* waiters) {
+    auto& w = *waiters;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!w.waiting.load(std::memory_order_relaxed)) return;
+    if (!w.waiting.exchange(0, std::memory_order_relaxed)) return;
+
+    w.sequence.fetch_add(1, std::memory_order_release);
+    futex_wake(&w.sequence, INT32_MAX);
+}
+
+CONST_VAR s64 CHANNEL_SPIN_COUNT = 64;
+
+// Keeps calling "try_op" until it succeeds or "milliseconds" run out (-1 waits forever):
+template<typename Try_Op>
+auto channel_wait(Channel_Waiters* waiters, s32 milliseconds, Try_Op try_op) -> bool {
+    auto& w = *waiters;
+
+    for (s64 i = 0; i < CHANNEL_SPIN_COUNT; ++i) {
+        if (try_op()) return true;
+        cpu_relax();
+    }
+
+    s64 deadline = {};
+    if (milliseconds >= 0) deadline = get_monotonic_milliseconds() + milliseconds;
+
+    while (true) {
+        auto sequence = w.sequence.load(std::memory_order_acquire);
+
+        // NOTE(WALKER): Registrations are only ever cleared by a wake, one left behind by an early
+        //               return just costs the other side a single spurious futex_wake().
+        w.waiting.fetch_add(1, std::memory_order_seq_cst);
+        if (try_op()) return true;
+
+        s32 remaining = -1;
+        if (milliseconds >= 0) remaining = (s32) max(deadline - get_monotonic_milliseconds(), (s64) 0);
+
+        Wait_For_Result result = Wait_For_Result::TIMEOUT;
+        if (remaining) result = futex_wait(&w.sequence, sequence, remaining);
+
+        if (try_op()) return true;
+        if (result != Wait_For_Result::SUCCESS) return false;
+    }
+}
+
+// Single producer, single consumer:
+// Each side keeps a cached copy of the other side's index and only reloads it when the ring looks full/empty.
+template<typename T>
+struct SPSC_Channel {
+    // Receiver:
+    std::atomic<s64> head        = {};
+    s64              cached_tail = {};
+    u8               padding_0[CACHE_LINE_SIZE - 2 * sizeof(s64)];
+
+    // Sender:
+    std::atomic<s64> tail        = {};
+    s64              cached_head = {};
+    u8               padding_1[CACHE_LINE_SIZE - 2 * sizeof(s64)];
+
+    T*               slots       = {};
+    s64              mask        = {};
+    Channel_Waiters  not_empty   = {};
+    Channel_Waiters  not_full    = {};
+
+    Allocator        allocator   = {};
+};
+
+// "capacity" is rounded up to a power of 2:
+template<typename T>
+void init(SPSC_Channel<T>* channel, s64 capacity) {
+    auto& c = *channel;
+
+    remember_allocators(channel);
+
+    capacity = next_pow2(max(capacity, (s64) 1));
+
+    push_allocator(c.allocator,
+        c.slots = NewArray<T>(capacity).data;
+    )
+    c.mask = capacity - 1;
+
+    c.head.store(0, std::memory_order_relaxed);
+    c.tail.store(0, std::memory_order_relaxed);
+    c.cached_head = 0;
+    c.cached_tail = 0;
+}
+
+template<typename T>
+void deinit(SPSC_Channel<T>* channel) {
+    auto& c = *channel;
+
+    for (s64 i = 0; i <= c.mask; ++i) c.slots[i].~T();
+    push_allocator(c.allocator, dealloc(c.slots, (c.mask + 1) * (s64) sizeof(T));)
+
+    c.slots = {};
+    c.mask  = {};
+}
+
+// Sender only:
+template<typename T>
+auto try_send(SPSC_Channel<T>* channel, const T& item) -> bool {
+    auto& c = *channel;
+
+    auto tail = c.tail.load(std::memory_order_relaxed);
+    if (tail - c.cached_head > c.mask) {
+        c.cached_head = c.head.load(std::memory_order_acquire);
+        if (tail - c.cached_head > c.mask) return false;
+    }
+
+    c.slots[tail & c.mask] = item;
+    c.tail.store(tail + 1, std::memory_order_release);
+
+    channel_notify(&c.not_empty);
+    return true;
+}
+
+// Receiver only:
+template<typename T>
+auto try_receive(SPSC_Channel<T>* channel, T* item) -> bool {
+    auto& c = *channel;
+
+    auto head = c.head.load(std::memory_order_relaxed);
+    if (head == c.cached_tail) {
+        c.cached_tail = c.tail.load(std::memory_order_acquire);
+        if (head == c.cached_tail) return false;
+    }
+
+    *item = c.slots[head & c.mask];
+    c.head.store(head + 1, std::memory_order_release);
+
+    channel_notify(&c.not_full);
+    return true;
+}
+
+// Blocks while the channel is full, false if it still was after "milliseconds":
+template<typename T>
+auto send(SPSC_Channel<T>* channel, const T& item, s32 milliseconds = -1) -> bool {
+    return channel_wait(&channel->not_full, milliseconds, [&]() { return try_send(channel, item); });
+}
+
+// Blocks while the channel is empty, false if it still was after "milliseconds":
+template<typename T>
+auto receive(SPSC_Channel<T>* channel, T* item, s32 milliseconds = -1) -> bool {
+    return channel_wait(&channel->not_empty, milliseconds, [&]() { return try_receive(channel, item); });
+}
+
+// Multi producer, multi consumer:
+// A cell's sequence tells whose turn it is. It equals the position when the cell is free for the sender
+// at that position, and the position + 1 once it holds an item for the receiver at that position.
+template<typename T>
+struct MPMC_Channel_Cell {
+    std::atomic<s64> sequence = {};
+    T                item     = {};
+};
+
+template<typename T>
+struct MPMC_Channel {
+    std::atomic<s64>          send_position    = {};
+    u8                        padding_0[CACHE_LINE_SIZE - sizeof(std::atomic<s64>)];
+    std::atomic<s64>          receive_position = {};
+    u8                        padding_1[CACHE_LINE_SIZE - sizeof(std::atomic<s64>)];
+
+    MPMC_Channel_Cell<T>*     cells            = {};
+    s64                       mask             = {};
+    Channel_Waiters           not_empty        = {};
+    Channel_Waiters           not_full         = {};
+
+    Allocator                 allocator        = {};
+};
+
+// "capacity" is rounded up to a power of 2 (at least 2):
+template<typename T>
+void init(MPMC_Channel<T>* channel, s64 capacity) {
+    auto& c = *channel;
+
+    remember_allocators(channel);
+
+    capacity = next_pow2(max(capacity, (s64) 2));
+
+    push_allocator(c.allocator,
+        c.cells = NewArray<MPMC_Channel_Cell<T>>(capacity).data;
+    )
+    c.mask = capacity - 1;
+
+    for (s64 i = 0; i < capacity; ++i) c.cells[i].sequence.store(i, std::memory_order_relaxed);
+
+    c.send_position.store(0, std::memory_order_relaxed);
+    c.receive_position.store(0, std::memory_order_relaxed);
+}
+
+template<typename T>
+void deinit(MPMC_Channel<T>* channel) {
+    auto& c = *channel;
+
+    for (s64 i = 0; i <= c.mask; ++i) c.cells[i].~MPMC_Channel_Cell<T>();
+    push_allocator(c.allocator, dealloc(c.cells, (c.mask + 1) * (s64) sizeof(MPMC_Channel_Cell<T>));)
+
+    c.cells = {};
+    c.mask  = {};
+}
+
+template<typename T>
+auto try_send(MPMC_Channel<T>* channel, const T& item) -> bool {
+    auto& c = *channel;
+
+    MPMC_Channel_Cell<T>* cell = {};
+
+    auto position = c.send_position.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &c.cells[position & c.mask];
+
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff     = sequence - position;
+
+        if (diff == 0) {
+            if (c.send_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            position = c.send_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->item = item;
+    cell->sequence.store(position + 1, std::memory_order_release);
+
+    channel_notify(&c.not_empty);
+    return true;
+}
+
+template<typename T>
+auto try_receive(MPMC_Channel<T>* channel, T* item) -> bool {
+    auto& c = *channel;
+
+    MPMC_Channel_Cell<T>* cell = {};
+
+    auto position = c.receive_position.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &c.cells[position & c.mask];
+
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        auto diff     = sequence - (position + 1);
+
+        if (diff == 0) {
+            if (c.receive_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            position = c.receive_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    *item = cell->item;
+    cell->sequence.store(position + c.mask + 1, std::memory_order_release);
+
+    channel_notify(&c.not_full);
+    return true;
+}
+
+template<typename T>
+auto send(MPMC_Channel<T>* channel, const T& item, s32 milliseconds = -1) -> bool {
+    return channel_wait(&channel->not_full, milliseconds, [&]() { return try_send(channel, item); });
+}
+
+template<typename T>
+auto receive(MPMC_Channel<T>* channel, T* item, s32 milliseconds = -1) -> bool {
+    return channel_wait(&channel->not_empty, milliseconds, [&]() { return try_receive(channel, item); });
+}
@@ -1,22 +1,84 @@
-struct Mutex {
-    pthread_mutex_t mutex = {};
+// Lock debugging: #define DEBUG_LOCKS above "Threads/module.hpp" (or build with -DDEBUG_LOCKS).
+// Every lock then carries a Lock_Debug with a name, an optional order and contention counters.
+// Locks with an order >= 0 have to be taken in increasing order, taking one while holding a lock of the
+// same or a higher order (or taking a lock this thread already holds) gets reported on stderr.
+// Without DEBUG_LOCKS the name/order given to init() are ignored and nothing is counted.
+#ifdef DEBUG_LOCKS
+
+#include <cstdio>
+
+struct Lock_Debug {
+    const char*      name         = "";
+    s64              order        = -1;
+
+    std::atomic<s64> acquisitions = {};
+    std::atomic<s64> contended    = {}; // couldn't take it right away
+    std::atomic<s64> sleeps       = {}; // had to go to the kernel
+};
+
+CONST_VAR s64 MAX_HELD_LOCKS = 32;
+
+thread_local Lock_Debug* held_locks[MAX_HELD_LOCKS];
+thread_local s64         held_lock_count = {};
+
+void init(Lock_Debug* debug, const char* name, s64 order) {
+    debug->name  = name;
+    debug->order = order;
+}
+
+// Call before blocking on the lock, so a deadlock gets reported before it happens:
+void lock_debug_check(Lock_Debug* debug) {
+    // Past MAX_HELD_LOCKS the extra locks aren't recorded (lock_debug_acquired only counts them):
+    auto count = min(held_lock_count, MAX_HELD_LOCKS);
+    for (s64 i = 0; i < count; ++i) {
+        auto held = held_locks[i];
+
+        if (held == debug) {
+            fprintf(stderr, "Lock \"%s\" taken again by the thread already holding it.\n", debug->name);
+        } else if (debug->order >= 0 && held->order >= debug->order) {
+            fprintf(stderr, "Lock order violation: \"%s\" (order %ld) taken while holding \"%s\" (order %ld).\n",
+                    debug->name, debug->order, held->name, held->order);
+        }
+    }
+}
 
-    /* DEBUG_MODE stuff:
-    bool initialized           = {};
+void lock_debug_acquired(Lock_Debug* debug, bool contended) {
+    debug->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) debug->contended.fetch_add(1, std::memory_order_relaxed);
 
-    String name                = {};
-    Mutex_Order order          = {};
+    if (held_lock_count < MAX_HELD_LOCKS) held_locks[held_lock_count] = debug;
+    held_lock_count += 1;
+}
 
-    s32 redundant_lock_counter = {};
+void lock_debug_released(Lock_Debug* debug) {
+    auto count = min(held_lock_count, MAX_HELD_LOCKS);
+    for (auto i = count - 1; i >= 0; --i) {
+        if (held_locks[i] != debug) continue;
 
-    String outer_name          = {};
-    Mutex_Order outer_order    = {};
-    Mutex* outer_mutex         = {};
-    */
+        for (auto j = i; j < count - 1; ++j) held_locks[j] = held_locks[j + 1];
+        break;
+    }
+    held_lock_count -= 1;
+}
+
+#endif
+
+struct Mutex {
+    pthread_mutex_t mutex = {};
+
+#ifdef DEBUG_LOCKS
+    Lock_Debug      debug = {};
+#endif
 };
 
-void init(Mutex* m) {
+void init(Mutex* m, const char* name = "", s64 order = -1) {
     pthread_mutex_init(&m->mutex, nullptr);
+
+#ifdef DEBUG_LOCKS
+    init(&m->debug, name, order);
+#else
+    (void) name; (void) order;
+#endif
 }
 
 void destroy(Mutex* m) {
@@ -24,10 +86,23 @@ void destroy(Mutex* m) {
 }
 
 void lock(Mutex* m) {
+#ifdef DEBUG_LOCKS
+    lock_debug_check(&m->debug);
+
+    bool contended = pthread_mutex_trylock(&m->mutex) != 0;
+    if (contended) pthread_mutex_lock(&m->mutex);
+
+    lock_debug_acquired(&m->debug, contended);
+#else
     pthread_mutex_lock(&m->mutex);
+#endif
 }
 
 void unlock(Mutex* m) {
+#ifdef DEBUG_LOCKS
+    lock_debug_released(&m->debug);
+#endif
+
     pthread_mutex_unlock(&m->mutex);
 }
 
@@ -87,6 +162,442 @@ auto wait_for(Semaphore* s, s32 milliseconds = -1) -> Wait_For_Result {
     return Wait_For_Result::SUCCESS;
 }
 
+// Hint to the CPU that we are in a spin-wait loop:
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Futex wrappers (Linux only), these are the building blocks for Parker and Event below.
+// NOTE(WALKER): std::atomic<u32> is assumed to have the same layout as a u32, which holds on every compiler we care about.
+auto futex_wait(std::atomic<u32>* address, u32 expected, s32 milliseconds = -1) -> Wait_For_Result {
+    timespec  timeout   = {};
+    timespec* timeout_p = {};
+
+    if (milliseconds >= 0) {
+        timeout.tv_sec  = milliseconds / 1000;
+        timeout.tv_nsec = (milliseconds % 1000) * 1000000L;
+        timeout_p       = &timeout;
+    }
+
+    auto result = syscall(SYS_futex, (u32*) address, FUTEX_WAIT_PRIVATE, expected, timeout_p, nullptr, 0);
+
+    if (result == -1) {
+        switch (errno) {
+            case EAGAIN:    return Wait_For_Result::SUCCESS; // value already changed
+            case EINTR:     return Wait_For_Result::SUCCESS; // spurious, caller re-checks
+            case ETIMEDOUT: return Wait_For_Result::TIMEOUT;
+                   default: return Wait_For_Result::ERROR;
+        }
+    }
+
+    return Wait_For_Result::SUCCESS;
+}
+
+void futex_wake(std::atomic<u32>* address, s32 count = 1) {
+    syscall(SYS_futex, (u32*) address, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+// A Parker lets exactly one thread (the owner) sleep until some other thread unparks it.
+// An unpark that happens before the park is remembered, so the owner can't miss it.
+// Unparking a thread that isn't parked is just an atomic exchange, no syscall.
+CONST_VAR u32 PARKER_EMPTY    = 0;
+CONST_VAR u32 PARKER_PARKED   = 1;
+CONST_VAR u32 PARKER_NOTIFIED = 2;
+
+struct Parker {
+    std::atomic<u32> state = {};
+};
+
+auto park(Parker* parker, s32 milliseconds = -1) -> Wait_For_Result {
+    auto& p = *parker;
+
+    // Consume a pending unpark:
+    u32 state = PARKER_NOTIFIED;
+    if (p.state.compare_exchange_strong(state, PARKER_EMPTY, std::memory_order_acquire, std::memory_order_relaxed)) {
+        return Wait_For_Result::SUCCESS;
+    }
+
+    if (!p.state.compare_exchange_strong(state, PARKER_PARKED, std::memory_order_acquire, std::memory_order_relaxed)) {
+        // Got unparked in between:
+        p.state.store(PARKER_EMPTY, std::memory_order_relaxed);
+        return Wait_For_Result::SUCCESS;
+    }
+
+    while (true) {
+        auto result = futex_wait(&p.state, PARKER_PARKED, milliseconds);
+
+        state = PARKER_NOTIFIED;
+        if (p.state.compare_exchange_strong(state, PARKER_EMPTY, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return Wait_For_Result::SUCCESS;
+        }
+
+        if (result != Wait_For_Result::SUCCESS || milliseconds >= 0) {
+            state = PARKER_PARKED;
+            if (p.state.compare_exchange_strong(state, PARKER_EMPTY, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return result == Wait_For_Result::ERROR ? result : Wait_For_Result::TIMEOUT;
+            }
+
+            // Notified while timing out:
+            p.state.store(PARKER_EMPTY, std::memory_order_relaxed);
+            return Wait_For_Result::SUCCESS;
+        }
+    }
+}
+
+void unpark(Parker* parker) {
+    if (parker->state.exchange(PARKER_NOTIFIED, std::memory_order_release) == PARKER_PARKED) {
+        futex_wake(&parker->state);
+    }
+}
+
+// A manual reset Event: once set, every waiter (current and future) passes until it's reset.
+// Setting an Event nobody is waiting on doesn't make a syscall.
+CONST_VAR u32 EVENT_UNSET         = 0;
+CONST_VAR u32 EVENT_SET           = 1;
+CONST_VAR u32 EVENT_UNSET_WAITERS = 2;
+
+struct Event {
+    std::atomic<u32> state = {};
+};
+
+void set(Event* event) {
+    if (event->state.exchange(EVENT_SET, std::memory_order_release) == EVENT_UNSET_WAITERS) {
+        futex_wake(&event->state, INT32_MAX);
+    }
+}
+
+void reset(Event* event) {
+    u32 state = EVENT_SET;
+    event->state.compare_exchange_strong(state, EVENT_UNSET, std::memory_order_relaxed, std::memory_order_relaxed);
+}
+
+auto is_set(Event* event) -> bool {
+    return event->state.load(std::memory_order_acquire) == EVENT_SET;
+}
+
+auto get_monotonic_milliseconds() -> s64 {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (s64) now.tv_sec * 1000 + (s64) now.tv_nsec / 1000000;
+}
+
+auto wait_for(Event* event, s32 milliseconds = -1) -> Wait_For_Result {
+    auto& e = *event;
+
+    s64 deadline = {};
+    if (milliseconds >= 0) deadline = get_monotonic_milliseconds() + milliseconds;
+
+    while (true) {
+        auto state = e.state.load(std::memory_order_acquire);
+        if (state == EVENT_SET) return Wait_For_Result::SUCCESS;
+
+        if (state == EVENT_UNSET) {
+            if (!e.state.compare_exchange_weak(state, EVENT_UNSET_WAITERS, std::memory_order_acquire, std::memory_order_relaxed)) continue;
+        }
+
+        s32 remaining = -1;
+        if (milliseconds >= 0) {
+            remaining = (s32) max(deadline - get_monotonic_milliseconds(), (s64) 0);
+            if (!remaining) return Wait_For_Result::TIMEOUT;
+        }
+
+        auto result = futex_wait(&e.state, EVENT_UNSET_WAITERS, remaining);
+        if (result != Wait_For_Result::SUCCESS) {
+            if (is_set(event)) return Wait_For_Result::SUCCESS;
+            return result;
+        }
+    }
+}
+
+// Locks for short critical sections (a few dozen nanoseconds), where sleeping in the kernel would cost
+// far more than the work being protected:
+//   Spin_Mutex     - never sleeps, only for when the holder can't be preempted for long (or contention is rare).
+//   Adaptive_Mutex - spins for a while, then sleeps on a futex. Unlocking without waiters is one atomic, no syscall.
+//   RW_Lock        - any number of readers or one writer, for read-mostly data. Waiting writers block new readers.
+CONST_VAR s64 SPIN_MUTEX_YIELD_AFTER = 1024; // spins before we start giving up our time slice
+CONST_VAR s64 ADAPTIVE_SPIN_COUNT    = 128;
+
+struct Spin_Mutex {
+    std::atomic<u32> locked = {};
+
+#ifdef DEBUG_LOCKS
+    Lock_Debug       debug  = {};
+#endif
+};
+
+void init(Spin_Mutex* m, const char* name = "", s64 order = -1) {
+    m->locked.store(0, std::memory_order_relaxed);
+
+#ifdef DEBUG_LOCKS
+    init(&m->debug, name, order);
+#else
+    (void) name; (void) order;
+#endif
+}
+
+void destroy(Spin_Mutex*) {}
+
+auto try_lock(Spin_Mutex* m) -> bool {
+    return !m->locked.load(std::memory_order_relaxed) && !m->locked.exchange(1, std::memory_order_acquire);
+}
+
+void lock(Spin_Mutex* m) {
+#ifdef DEBUG_LOCKS
+    lock_debug_check(&m->debug);
+#endif
+
+    bool contended = false;
+    s64  spins     = 0;
+
+    // Test and test-and-set, only spin on loads so waiters don't fight over the cache line:
+    while (m->locked.exchange(1, std::memory_order_acquire)) {
+        contended = true;
+        while (m->locked.load(std::memory_order_relaxed)) {
+            if (++spins < SPIN_MUTEX_YIELD_AFTER) cpu_relax();
+            else                                  sched_yield();
+        }
+    }
+
+#ifdef DEBUG_LOCKS
+    lock_debug_acquired(&m->debug, contended);
+#else
+    (void) contended;
+#endif
+}
+
+void unlock(Spin_Mutex* m) {
+#ifdef DEBUG_LOCKS
+    lock_debug_released(&m->debug);
+#endif
+
+    m->locked.store(0, std::memory_order_release);
+}
+
+// States of an Adaptive_Mutex:
+CONST_VAR u32 MUTEX_UNLOCKED        = 0;
+CONST_VAR u32 MUTEX_LOCKED          = 1;
+CONST_VAR u32 MUTEX_LOCKED_SLEEPERS = 2; // somebody might be sleeping on it, unlock has to wake
+
+struct Adaptive_Mutex {
+    std::atomic<u32> state = {};
+
+#ifdef DEBUG_LOCKS
+    Lock_Debug       debug = {};
+#endif
+};
+
+void init(Adaptive_Mutex* m, const char* name = "", s64 order = -1) {
+    m->state.store(MUTEX_UNLOCKED, std::memory_order_relaxed);
+
+#ifdef DEBUG_LOCKS
+    init(&m->debug, name, order);
+#else
+    (void) name; (void) order;
+#endif
+}
+
+void destroy(Adaptive_Mutex*) {}
+
+auto try_lock(Adaptive_Mutex* m) -> bool {
+    u32 state = MUTEX_UNLOCKED;
+    return m->state.compare_exchange_strong(state, MUTEX_LOCKED, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+void lock(Adaptive_Mutex* m) {
+    auto& mu = *m;
+
+#ifdef DEBUG_LOCKS
+    lock_debug_check(&mu.debug);
+#endif
+
+    if (try_lock(m)) {
+#ifdef DEBUG_LOCKS
+        lock_debug_acquired(&mu.debug, false);
+#endif
+        return;
+    }
+
+    // Spin while the holder is (probably) still running:
+    for (s64 i = 0; i < ADAPTIVE_SPIN_COUNT; ++i) {
+        cpu_relax();
+        if (mu.state.load(std::memory_order_relaxed) == MUTEX_UNLOCKED && try_lock(m)) {
+#ifdef DEBUG_LOCKS
+            lock_debug_acquired(&mu.debug, true);
+#endif
+            return;
+        }
+    }
+
+    // Sleep. Whoever takes the lock from here on marks it as having sleepers, since we can't know if we were the last one:
+    while (mu.state.exchange(MUTEX_LOCKED_SLEEPERS, std::memory_order_acquire) != MUTEX_UNLOCKED) {
+#ifdef DEBUG_LOCKS
+        mu.debug.sleeps.fetch_add(1, std::memory_order_relaxed);
+#endif
+        futex_wait(&mu.state, MUTEX_LOCKED_SLEEPERS);
+    }
+
+#ifdef DEBUG_LOCKS
+    lock_debug_acquired(&mu.debug, true);
+#endif
+}
+
+void unlock(Adaptive_Mutex* m) {
+#ifdef DEBUG_LOCKS
+    lock_debug_released(&m->debug);
+#endif
+
+    if (m->state.exchange(MUTEX_UNLOCKED, std::memory_order_release) == MUTEX_LOCKED_SLEEPERS) {
+        futex_wake(&m->state);
+    }
+}
+
+// RW_Lock state bits, the rest is the number of readers holding it:
+CONST_VAR u32 RW_WRITER_LOCKED   = 1u << 31;
+CONST_VAR u32 RW_WRITER_WAITING  = 1u << 30;
+CONST_VAR u32 RW_READERS_WAITING = 1u << 29;
+CONST_VAR u32 RW_READER_MASK     = RW_READERS_WAITING - 1;
+
+struct RW_Lock {
+    std::atomic<u32> state = {};
+
+#ifdef DEBUG_LOCKS
+    Lock_Debug       debug = {};
+#endif
+};
+
+void init(RW_Lock* l, const char* name = "", s64 order = -1) {
+    l->state.store(0, std::memory_order_relaxed);
+
+#ifdef DEBUG_LOCKS
+    init(&l->debug, name, order);
+#else
+    (void) name; (void) order;
+#endif
+}
+
+void destroy(RW_Lock*) {}
+
+auto try_read_lock(RW_Lock* l) -> bool {
+    auto state = l->state.load(std::memory_order_relaxed);
+    while (!(state & (RW_WRITER_LOCKED | RW_WRITER_WAITING))) {
+        if (l->state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+void read_lock(RW_Lock* l) {
+    auto& rw = *l;
+
+#ifdef DEBUG_LOCKS
+    lock_debug_check(&rw.debug);
+#endif
+
+    bool contended = false;
+    s64  spins     = 0;
+
+    while (!try_read_lock(l)) {
+        contended = true;
+
+        if (spins++ < ADAPTIVE_SPIN_COUNT) {
+            cpu_relax();
+            continue;
+        }
+
+        // Tell the writer to wake us, then sleep until the state changes:
+        auto state = rw.state.load(std::memory_order_relaxed);
+        if (!(state & (RW_WRITER_LOCKED | RW_WRITER_WAITING))) continue;
+        if (!(state & RW_READERS_WAITING)) {
+            if (!rw.state.compare_exchange_weak(state, state | RW_READERS_WAITING, std::memory_order_relaxed, std::memory_order_relaxed)) continue;
+            state |= RW_READERS_WAITING;
+        }
+
+#ifdef DEBUG_LOCKS
+        rw.debug.sleeps.fetch_add(1, std::memory_order_relaxed);
+#endif
+        futex_wait(&rw.state, state);
+    }
+
+#ifdef DEBUG_LOCKS
+    lock_debug_acquired(&rw.debug, contended);
+#else
+    (void) contended;
+#endif
+}
+
+void read_unlock(RW_Lock* l) {
+#ifdef DEBUG_LOCKS
+    lock_debug_released(&l->debug);
+#endif
+
+    auto state = l->state.fetch_sub(1, std::memory_order_release);
+
+    // Last reader out lets a waiting writer in:
+    if ((state & RW_READER_MASK) == 1 && (state & RW_WRITER_WAITING)) futex_wake(&l->state, INT32_MAX);
+}
+
+auto try_write_lock(RW_Lock* l) -> bool {
+    auto state = l->state.load(std::memory_order_relaxed);
+    // NOTE(WALKER): RW_WRITER_WAITING stays set, other writers might be asleep and write_unlock() has to wake them.
+    while (!(state & (RW_WRITER_LOCKED | RW_READER_MASK))) {
+        if (l->state.compare_exchange_weak(state, state | RW_WRITER_LOCKED, std::memory_order_acquire, std::memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+void write_lock(RW_Lock* l) {
+    auto& rw = *l;
+
+#ifdef DEBUG_LOCKS
+    lock_debug_check(&rw.debug);
+#endif
+
+    bool contended = false;
+    s64  spins     = 0;
+
+    while (!try_write_lock(l)) {
+        contended = true;
+
+        // Stop new readers from coming in right away, otherwise a steady stream of them starves us:
+        auto state = rw.state.load(std::memory_order_relaxed);
+        if (!(state & RW_WRITER_WAITING)) {
+            if (!rw.state.compare_exchange_weak(state, state | RW_WRITER_WAITING, std::memory_order_relaxed, std::memory_order_relaxed)) continue;
+            state |= RW_WRITER_WAITING;
+        }
+
+        if (spins++ < ADAPTIVE_SPIN_COUNT) {
+            cpu_relax();
+            continue;
+        }
+
+        if (!(state & (RW_WRITER_LOCKED | RW_READER_MASK))) continue;
+
+#ifdef DEBUG_LOCKS
+        rw.debug.sleeps.fetch_add(1, std::memory_order_relaxed);
+#endif
+        futex_wait(&rw.state, state);
+    }
+
+#ifdef DEBUG_LOCKS
+    lock_debug_acquired(&rw.debug, contended);
+#else
+    (void) contended;
+#endif
+}
+
+// Wakes everybody that was waiting, other writers set their waiting bit again if they lose the race:
+void write_unlock(RW_Lock* l) {
+#ifdef DEBUG_LOCKS
+    lock_debug_released(&l->debug);
+#endif
+
+    auto state = l->state.fetch_and(~(RW_WRITER_LOCKED | RW_WRITER_WAITING | RW_READERS_WAITING), std::memory_order_release);
+    if (state & (RW_WRITER_WAITING | RW_READERS_WAITING)) futex_wake(&l->state, INT32_MAX);
+}
+
 struct Thread;
 struct Worker_Info;
 using Thread_Index = s64;
@@ -122,13 +633,30 @@ auto thread_entry_proc(void* parameter) -> void* {
     return (void*) result;
 }
 
-auto thread_init(Thread* thread, Thread_Proc proc) -> bool {
+// "affinity", if given, is the set of CPUs the thread is allowed to run on from the very start
+// (so everything it touches first is allocated on its own NUMA node).
+auto thread_init(Thread* thread, Thread_Proc proc, const cpu_set_t* affinity = nullptr) -> bool {
     auto& t = *thread;
 
     init(&t.is_alive_semaphore);
     init(&t.suspended_semaphore);
 
-    auto ok = pthread_create(&t.thread_handle, nullptr, thread_entry_proc, thread);
+    pthread_attr_t  attributes   = {};
+    pthread_attr_t* attributes_p = {};
+    if (affinity) {
+        pthread_attr_init(&attributes);
+        attributes_p = &attributes;
+
+        // Placement is best effort, a CPU set the kernel won't take just means default attributes:
+        if (pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set_t), affinity) != 0) {
+            pthread_attr_destroy(&attributes);
+            attributes_p = nullptr;
+        }
+    }
+
+    auto ok = pthread_create(&t.thread_handle, attributes_p, thread_entry_proc, thread);
+
+    if (attributes_p) pthread_attr_destroy(attributes_p);
 
     if (ok != 0) {
         destroy(&t.is_alive_semaphore);
@@ -136,7 +664,10 @@ auto thread_init(Thread* thread, Thread_Proc proc) -> bool {
         return false;
     }
 
+    // Start from a fresh Context, the Thread may live in memset memory,
+    // which would leave things like the temp allocator's alignment at zero:
     t.proc                       = proc;
+    t.starting_context           = {};
     t.starting_context.allocator = t.starting_context.temp_allocator;
     t.index                      = next_thread_index++;
 
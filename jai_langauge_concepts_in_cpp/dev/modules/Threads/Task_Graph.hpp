@@ -0,0 +1,102 @@
+// Task graphs (DAGs) on top of Thread_Group.
+//
+// Build the graph with task_graph_add() and task_graph_depends_on(), then task_graph_run() it.
+// Every node counts its unfinished predecessors, whichever worker finishes the last one pushes the
+// node onto its own queue (where idle workers can steal it), so chained stages never have to go
+// back through the producer thread.
+//
+// Nodes come from the temp allocator: build the graph, run it, and let the end of frame
+// reset_temp_allocator() throw it away, then build it again next frame.
+// NOTE(WALKER): A cycle means those nodes (and so task_graph_run()) never finish.
+
+struct Task_Graph;
+
+struct Task_Graph_Node {
+    Task_Graph*                       graph                   = {};
+    Task_Proc                         proc                    = {};
+    void*                             data                    = {};
+    Work_Priority                     priority                = Work_Priority::NORMAL;
+
+    s64                               predecessor_count       = {};
+    std::atomic<s64>                  unfinished_predecessors = {};
+    Resizable_Array<Task_Graph_Node*> successors              = {};
+};
+
+struct Task_Graph {
+    Resizable_Array<Task_Graph_Node*> nodes   = {};
+    Task_Counter                      counter = {};
+};
+
+auto task_graph_add(Task_Graph* graph, Task_Proc proc, void* data, Work_Priority priority = Work_Priority::NORMAL) -> Task_Graph_Node* /* uses temp_allocator */ {
+    auto& g = *graph;
+
+    Task_Graph_Node* result = {};
+    push_allocator(context.temp_allocator,
+        result = New<Task_Graph_Node>();
+    )
+
+    result->graph                = graph;
+    result->proc                 = proc;
+    result->data                 = data;
+    result->priority             = priority;
+    result->successors.allocator = context.temp_allocator;
+
+    g.nodes.allocator = context.temp_allocator;
+    array_add(&g.nodes, result);
+
+    return result;
+}
+
+// "node" won't start until "predecessor" is done:
+void task_graph_depends_on(Task_Graph_Node* node, Task_Graph_Node* predecessor) {
+    array_add(&predecessor->successors, node);
+    node->predecessor_count += 1;
+}
+
+void push_task_graph_node(Thread_Group* group, Task_Graph_Node* node);
+
+void run_task_graph_node(Thread_Group* group, Work_Entry* entry) {
+    auto& node = *(Task_Graph_Node*) entry->work;
+
+    node.proc(group, node.data);
+
+    // Released successors are counted on the graph's counter before run_task() finishes this node,
+    // so the counter can't touch zero while there is still work left in the graph:
+    for (auto successor : node.successors) {
+        if (successor->unfinished_predecessors.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            push_task_graph_node(group, successor);
+        }
+    }
+}
+
+void push_task_graph_node(Thread_Group* group, Task_Graph_Node* node) {
+    auto& g = *group;
+
+    auto entry = alloc_work_entries(&g.entry_pool, get_entry_cache(group), 1);
+    auto& e    = *entry;
+
+    e.work      = node;
+    e.task_proc = run_task_graph_node;
+    e.counter   = &node->graph->counter;
+    e.priority  = node->priority;
+
+    push_task(group, entry);
+}
+
+// Starts every node without predecessors and helps run the graph until all of it is done (see task_wait()).
+void task_graph_run(Thread_Group* group, Task_Graph* graph) {
+    auto& g = *graph;
+
+    // All counts have to be in place before the first node can finish:
+    for (auto node : g.nodes) node->unfinished_predecessors.store(node->predecessor_count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Hold a count of our own while pushing the roots, so an early root finishing can't make the graph look done:
+    task_counter_add(&g.counter, 1);
+    for (auto node : g.nodes) {
+        if (!node->predecessor_count) push_task_graph_node(group, node);
+    }
+    task_counter_finish(&g.counter);
+
+    task_wait(group, &g.counter);
+}
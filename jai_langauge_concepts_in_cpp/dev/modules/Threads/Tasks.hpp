@@ -0,0 +1,189 @@
+// Fork/join and parallel_for on top of Thread_Group.
+//
+// Tasks carry their own proc, so they can be mixed with the group's regular work. A task spawned from
+// inside a worker goes onto that worker's own deque, idle workers steal it, which is what spreads the
+// work across cores. Waiting on a Task_Counter doesn't sleep, the waiting thread helps run tasks until
+// the counter hits zero.
+//
+// NOTE(WALKER): From outside the group these follow the same rule as thread_group_add_work(), only
+//               the one producer thread should call them.
+
+void run_user_task(Thread_Group* group, Work_Entry* entry) {
+    entry->user_task(group, entry->work);
+}
+
+// Runs "proc(group, data)" on the group, "counter" is decremented once it's done.
+void task_spawn(Thread_Group* group, Task_Counter* counter, Task_Proc proc, void* data, Work_Priority priority = Work_Priority::NORMAL) {
+    auto& g = *group;
+
+    auto entry = alloc_work_entries(&g.entry_pool, get_entry_cache(group), 1);
+    auto& e    = *entry;
+
+    e.work      = data;
+    e.task_proc = run_user_task;
+    e.user_task = proc;
+    e.counter   = counter;
+    e.priority  = priority;
+
+    push_task(group, entry);
+}
+
+// For threads outside the group: take something off of any worker's deque, highest priority first.
+auto steal_any(Thread_Group* group, u64* random_state) -> Work_Entry* {
+    auto& g = *group;
+
+    auto num_workers = g.worker_info.count;
+    if (num_workers <= 0) return nullptr;
+
+    auto x = *random_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *random_state = x;
+
+    auto start = (s64)(x % (u64) num_workers);
+    for (s64 priority = 0; priority < WORK_PRIORITY_COUNT; ++priority) {
+        for (s64 i = 0; i < num_workers; ++i) {
+            auto entry = deque_steal(&g.worker_info[(start + i) % num_workers].info.available[priority]);
+            if (entry) return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+CONST_VAR s64 TASK_WAIT_SPIN_COUNT = 64;
+
+// Helps run work until every task counted by "counter" is done.
+// NOTE(WALKER): A worker helping out can pick up regular group work too, a STOP returned from it is ignored here.
+void task_wait(Thread_Group* group, Task_Counter* counter) {
+    auto& g = *group;
+
+    auto worker   = current_worker_info;
+    bool in_group = worker && worker->info.group == group;
+
+    u64 random_state = (u64)(size_t) counter | 1;
+    s64 idle_spins   = {};
+
+    // Not "pending", the last finisher may still be writing to the counter after that hits zero:
+    while (!is_done(counter)) {
+        Work_Entry* entry = {};
+
+        if (in_group) {
+            entry = find_work(worker);
+        } else {
+            entry = steal_any(group, &random_state);
+        }
+
+        if (!entry) {
+            idle_spins += 1;
+            if (idle_spins < TASK_WAIT_SPIN_COUNT) cpu_relax();
+            else                                   sched_yield();
+            continue;
+        }
+
+        idle_spins = 0;
+
+        if (in_group) {
+            execute_work_entry(worker, entry);
+        } else if (entry->task_proc) {
+            run_task(group, entry);
+        } else {
+            // Regular work needs a worker's Thread, hand it back to one:
+            auto thread_index = pick_worker(group);
+            auto& info        = g.worker_info[thread_index].info;
+            inbox_push(&info.incoming, entry, entry);
+            if (info.sleeping.load(std::memory_order_seq_cst)) unpark(&info.parker);
+        }
+    }
+}
+
+// parallel_for(): calls "proc(sub_begin, sub_end)" over [begin, end) in pieces of at least "grain" items.
+// Ranges are split lazily: a worker only splits off half of its range while its own deque is empty
+// (nothing left for thieves to take), otherwise it keeps chewing through grain sized pieces itself.
+// That way the amount of splitting adapts to how many workers are actually idle.
+template<typename Proc>
+struct Parallel_For {
+    Proc*         proc    = {};
+    s64           grain   = {};
+    Task_Counter* counter = {};
+};
+
+template<typename Proc>
+void parallel_for_task(Thread_Group* group, Work_Entry* entry);
+
+template<typename Proc>
+void parallel_for_range(Thread_Group* group, Parallel_For<Proc>* data, s64 begin, s64 end) {
+    auto& d = *data;
+    auto& g = *group;
+
+    auto worker = current_worker_info;
+    bool in_group = worker && worker->info.group == group;
+
+    while (end - begin > d.grain) {
+        if (in_group && has_queued_work(worker)) {
+            (*d.proc)(begin, begin + d.grain);
+            begin += d.grain;
+            continue;
+        }
+
+        auto middle = begin + (end - begin) / 2;
+
+        auto entry = alloc_work_entries(&g.entry_pool, get_entry_cache(group), 1);
+        auto& e    = *entry;
+
+        e.work        = data;
+        e.task_proc   = parallel_for_task<Proc>;
+        e.counter     = d.counter;
+        e.range_begin = middle;
+        e.range_end   = end;
+
+        push_task(group, entry);
+
+        end = middle;
+    }
+
+    if (begin < end) (*d.proc)(begin, end);
+}
+
+template<typename Proc>
+void parallel_for_task(Thread_Group* group, Work_Entry* entry) {
+    parallel_for_range(group, (Parallel_For<Proc>*) entry->work, entry->range_begin, entry->range_end);
+}
+
+template<typename Proc>
+void parallel_for(Thread_Group* group, s64 begin, s64 end, s64 grain, Proc proc) {
+    if (begin >= end) return;
+    if (grain < 1) grain = 1;
+
+    Task_Counter counter;
+
+    Parallel_For<Proc> data;
+    data.proc    = &proc;
+    data.grain   = grain;
+    data.counter = &counter;
+
+    auto worker = current_worker_info;
+    if (worker && worker->info.group == group) {
+        // Our own share of the range counts as pending work too, until we're done splitting and running it:
+        task_counter_add(&counter, 1);
+        parallel_for_range(group, &data, begin, end);
+        task_counter_finish(&counter);
+    } else {
+        // From outside the group, hand the whole range to a worker to split up and help from the outside:
+        auto& g = *group;
+
+        auto entry = alloc_work_entries(&g.entry_pool, get_entry_cache(group), 1);
+        auto& e    = *entry;
+
+        e.work        = &data;
+        e.task_proc   = parallel_for_task<Proc>;
+        e.counter     = &counter;
+        e.range_begin = begin;
+        e.range_end   = end;
+
+        push_task(group, entry);
+    }
+
+    task_wait(group, &counter);
+}
@@ -1,4 +1,86 @@
 struct Thread_Group;
+struct Work_Entry;
+
+// Counts outstanding work: tasks (see Tasks.hpp) and regular work added with a counter.
+// Tasks are Work_Entries with a task_proc, the worker runs that instead of the group's proc and they
+// never show up in thread_group_get_completed_work(). A producer can block on it with wait_for() instead of polling.
+// NOTE(WALKER): Pending work and the "somebody is sleeping" bit share one word, so adding work and the last finisher
+//               can't interleave: whichever lands second sees the other. The last finisher's update is its final
+//               access, once wait_for()/is_done() see zero nobody touches the counter anymore and it can go out of scope.
+//               Pending lives in the upper 31 bits, more than 2^31 outstanding items on one counter isn't supported.
+CONST_VAR u32 TASK_COUNTER_WAITERS = 1; // somebody might be sleeping on it, the last finisher has to wake
+CONST_VAR u32 TASK_COUNTER_ONE     = 2; // one pending item
+
+struct Task_Counter {
+    std::atomic<u32> state = {}; // (pending * TASK_COUNTER_ONE) | TASK_COUNTER_WAITERS, a zeroed counter has nothing to wait for
+};
+
+void task_counter_add(Task_Counter* counter, s64 count) {
+    counter->state.fetch_add((u32) count * TASK_COUNTER_ONE, std::memory_order_relaxed);
+}
+
+void task_counter_finish(Task_Counter* counter) {
+    auto state = &counter->state;
+    auto old   = state->load(std::memory_order_relaxed);
+
+    while (true) {
+        auto next = old - TASK_COUNTER_ONE;
+        if (next == TASK_COUNTER_WAITERS) next = 0; // last one out clears the waiter bit and wakes everybody
+
+        if (state->compare_exchange_weak(old, next, std::memory_order_acq_rel, std::memory_order_relaxed)) break;
+    }
+
+    if (old == TASK_COUNTER_ONE + TASK_COUNTER_WAITERS) {
+        futex_wake(state, INT32_MAX); // only the address, the counter itself may be gone by now
+    }
+}
+
+auto is_done(Task_Counter* counter) -> bool {
+    return counter->state.load(std::memory_order_acquire) < TASK_COUNTER_ONE;
+}
+
+auto wait_for(Task_Counter* counter, s32 milliseconds = -1) -> Wait_For_Result {
+    auto& c = *counter;
+
+    s64 deadline = {};
+    if (milliseconds >= 0) deadline = get_monotonic_milliseconds() + milliseconds;
+
+    while (true) {
+        auto state = c.state.load(std::memory_order_acquire);
+        if (state < TASK_COUNTER_ONE) return Wait_For_Result::SUCCESS;
+
+        if (!(state & TASK_COUNTER_WAITERS)) {
+            if (!c.state.compare_exchange_weak(state, state | TASK_COUNTER_WAITERS, std::memory_order_acquire, std::memory_order_relaxed)) continue;
+            state |= TASK_COUNTER_WAITERS;
+        }
+
+        s32 remaining = -1;
+        if (milliseconds >= 0) {
+            remaining = (s32) max(deadline - get_monotonic_milliseconds(), (s64) 0);
+            if (!remaining) return Wait_For_Result::TIMEOUT;
+        }
+
+        // Any other finisher changes the word too, the futex just returns and we go around again:
+        auto result = futex_wait(&c.state, state, remaining);
+        if (result != Wait_For_Result::SUCCESS) {
+            if (is_done(counter)) return Wait_For_Result::SUCCESS;
+            return result;
+        }
+    }
+}
+
+// Every worker keeps one queue per priority and always runs the highest non-empty one first,
+// with a starvation guard so background work still gets a turn under a constant stream of higher priority work.
+enum class Work_Priority : u8 {
+    HIGH,
+    NORMAL,
+    BACKGROUND
+};
+
+CONST_VAR s64 WORK_PRIORITY_COUNT = 3;
+
+using Task_Proc       = void(*)(Thread_Group* group, void* data);
+using Work_Entry_Proc = void(*)(Thread_Group* group, Work_Entry* entry);
 
 struct Work_Entry {
     Work_Entry*  next            = {};
@@ -7,95 +89,437 @@ struct Work_Entry {
     String       logging_name    = {};
 
     f64          issue_time      = -1.0;
+    f64          completion_time = -1.0;
     s64          work_list_index = -1;
+    s64          executed_by     = -1; // worker_index that ran it
+
+    Task_Counter*   counter       = {};
+    Work_Priority   priority      = Work_Priority::NORMAL;
+
+    // Tasks only:
+    Work_Entry_Proc task_proc     = {};
+    Task_Proc       user_task     = {};
+    s64             range_begin   = {};
+    s64             range_end     = {};
 };
 
-struct Work_List {
-    Semaphore   semaphore = {};
-    Mutex       mutex     = {};
+// Work_Entry nodes are recycled instead of going through the allocator for every job.
+// Each thread has a Work_Entry_Cache it can use without synchronization, caches refill from and
+// spill into the shared Work_Entry_Pool in chunks, and only a pool miss allocates (a whole slab at a time).
+CONST_VAR s64 WORK_ENTRY_SLAB_COUNT     = 256;
+CONST_VAR s64 WORK_ENTRY_CACHE_TRANSFER = 128;
+CONST_VAR s64 WORK_ENTRY_CACHE_LIMIT    = WORK_ENTRY_CACHE_TRANSFER * 4;
 
-    Work_Entry* first     = {};
-    Work_Entry* last      = {};
-    s64         count     = {};
+struct Work_Entry_Slab {
+    Work_Entry_Slab* next  = {};
+    s64              count = {};
 };
 
-struct Worker_Info {
-    // NOTE(WALKER): Must match the anonymous struct below for align_forward to work
-    struct Unpadded_Worker_Info {
-        Thread        thread       = {};
-        Work_List     available    = {};
-        Work_List     completed    = {};
+struct Work_Entry_Cache {
+    Work_Entry*      first       = {};
+    s64              count       = {};
 
-        Thread_Group* group        = {};
-        s64           worker_index = -1;
-    };
+    // Written only by the owning thread, atomic so thread_group_get_pool_stats() can read them:
+    std::atomic<s64> cache_hits  = {};
+    std::atomic<s64> shared_hits = {};
+    std::atomic<s64> misses      = {};
+};
 
-    union {
-        // struct {
-        //     Thread        thread       = {};
-        //     Work_List     available    = {};
-        //     Work_List     completed    = {};
+struct Work_Entry_Pool {
+    Adaptive_Mutex   mutex      = {}; // held for a handful of pointer swaps at a time
+    Work_Entry*      first      = {};
+    s64              count      = {};
+    Work_Entry_Slab* slabs      = {};
+    s64              slab_count = {};
 
-        //     Thread_Group* group        = {};
-        //     s64           worker_index = -1;
-        // };
-        Unpadded_Worker_Info info               = {};
-        u8                   padding[align_forward(sizeof(Unpadded_Worker_Info), CACHE_LINE_SIZE)];
-    };
-    Array_View<s64>          work_steal_indices = {};
+    Allocator        allocator  = {};
 };
 
-void init_work_list(Work_List* list) {
-    init(&list->semaphore);
-    init(&list->mutex);
+struct Work_Entry_Pool_Stats {
+    s64 cache_hits     = {}; // served from a thread's own cache
+    s64 shared_hits    = {}; // cache was empty, refilled from the shared pool
+    s64 misses         = {}; // shared pool was empty too, had to allocate
+    s64 slab_count     = {};
+    s64 slab_entries   = {}; // total entries ever allocated
+    s64 shared_entries = {}; // currently sitting in the shared pool
+};
+
+void init_work_entry_pool(Work_Entry_Pool* pool) {
+    remember_allocators(pool);
+    init(&pool->mutex, "Work_Entry_Pool");
+}
+
+void deinit_work_entry_pool(Work_Entry_Pool* pool) {
+    auto& p = *pool;
+
+    while (p.slabs) {
+        auto next = p.slabs->next;
+        push_allocator(p.allocator, dealloc(p.slabs, (s64) sizeof(Work_Entry_Slab) + p.slabs->count * (s64) sizeof(Work_Entry));)
+        p.slabs = next;
+    }
+
+    p.first      = {};
+    p.count      = {};
+    p.slab_count = {};
+    destroy(&p.mutex);
 }
 
-void deinit_work_list(Work_List* list) {
-    destroy(&list->semaphore);
-    destroy(&list->mutex);
+void bump_counter(std::atomic<s64>* counter, s64 amount = 1) {
+    counter->store(counter->load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
 }
 
-void add_work(Work_List* list, Work_Entry* entry) {
-    auto& l = *list;
+// Hands back "count" entries linked through next, the tail's next is null.
+// A miss allocates all of the missing entries as one contiguous slab.
+auto alloc_work_entries(Work_Entry_Pool* pool, Work_Entry_Cache* cache, s64 count) -> Work_Entry* {
+    auto& p = *pool;
+    auto& c = *cache;
+
+    Work_Entry* result = {};
+    s64         needed = count;
+
+    auto take_from_cache = [&]() {
+        while (needed && c.first) {
+            auto entry  = c.first;
+            c.first     = entry->next;
+            c.count    -= 1;
+            new (entry) Work_Entry; // recycled, clear out the last job
+            entry->next = result;
+            result      = entry;
+            needed     -= 1;
+        }
+    };
 
-    {
-        lock(&l.mutex);
-        defer { unlock(&l.mutex); };
+    take_from_cache();
+    if (!needed) {
+        bump_counter(&c.cache_hits, count);
+        return result;
+    }
+    bump_counter(&c.cache_hits, count - needed);
+
+    lock(&p.mutex);
+    defer { unlock(&p.mutex); };
+
+    // Refill the cache from the shared pool:
+    if (p.first) {
+        auto want = needed + WORK_ENTRY_CACHE_TRANSFER;
+        while (want && p.first) {
+            auto entry = p.first;
+            p.first     = entry->next;
+            p.count    -= 1;
+            entry->next = c.first;
+            c.first     = entry;
+            c.count    += 1;
+            want       -= 1;
+        }
 
-        if (l.last) {
-            l.last->next = entry;
+        auto before = needed;
+        take_from_cache();
+        bump_counter(&c.shared_hits, before - needed);
+        if (!needed) return result;
+    }
+
+    // Miss: allocate a new slab, anything past what we need goes into the cache:
+    auto slab_entries = max(needed, WORK_ENTRY_SLAB_COUNT);
+
+    Work_Entry_Slab* slab = {};
+    push_allocator(p.allocator,
+        slab = (Work_Entry_Slab*) alloc((s64)sizeof(Work_Entry_Slab) + slab_entries * (s64)sizeof(Work_Entry));
+    )
+    slab->next  = p.slabs;
+    slab->count = slab_entries;
+    p.slabs       = slab;
+    p.slab_count += 1;
+
+    auto entries = (Work_Entry*)(slab + 1);
+    for (s64 i = 0; i < slab_entries; ++i) {
+        auto entry = new (&entries[i]) Work_Entry;
+        if (i < needed) {
+            entry->next = result;
+            result      = entry;
         } else {
-            l.first      = entry;
+            entry->next = c.first;
+            c.first     = entry;
+            c.count    += 1;
         }
+    }
+    bump_counter(&c.misses, needed);
+
+    return result;
+}
+
+void free_work_entry(Work_Entry_Pool* pool, Work_Entry_Cache* cache, Work_Entry* entry) {
+    auto& p = *pool;
+    auto& c = *cache;
+
+    entry->next = c.first;
+    c.first     = entry;
+    c.count    += 1;
+
+    if (c.count <= WORK_ENTRY_CACHE_LIMIT) return;
+
+    // Spill some back so other threads can use them:
+    lock(&p.mutex);
+    defer { unlock(&p.mutex); };
+
+    for (s64 i = 0; i < WORK_ENTRY_CACHE_TRANSFER; ++i) {
+        auto spilled  = c.first;
+        c.first       = spilled->next;
+        c.count      -= 1;
+        spilled->next = p.first;
+        p.first       = spilled;
+        p.count      += 1;
+    }
+}
+
+// Lock-free inbox that any thread can push onto and only the owning worker drains.
+// This is how work from outside the group (main thread, etc.) reaches a worker's Work_Deque.
+struct Work_Inbox {
+    std::atomic<Work_Entry*> first = {};
+};
+
+// Splices the already linked chain first->...->last onto the inbox with a single CAS:
+// NOTE(WALKER): seq_cst so the push is ordered before the pusher checks whether the owner is asleep (see wait_for_work()).
+void inbox_push(Work_Inbox* inbox, Work_Entry* first, Work_Entry* last) {
+    auto& i = *inbox;
+
+    auto head = i.first.load(std::memory_order_relaxed);
+    do {
+        last->next = head;
+    } while (!i.first.compare_exchange_weak(head, first, std::memory_order_seq_cst, std::memory_order_relaxed));
+}
+
+auto inbox_take_all(Work_Inbox* inbox) -> Work_Entry* {
+    return inbox->first.exchange(nullptr, std::memory_order_acquire);
+}
+
+// Chase-Lev work stealing deque (see "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013).
+// The owning worker pushes and pops at the bottom, any other thread steals from the top.
+// NOTE(WALKER): Old buffers can still be read by a thief that loaded them before a grow,
+//               so they are kept on the retired chain and only freed in deinit_work_deque().
+struct Work_Deque_Buffer {
+    s64                       mask    = {};
+    std::atomic<Work_Entry*>* slots   = {};
+    Work_Deque_Buffer*        retired = {};
+};
+
+CONST_VAR s64 WORK_DEQUE_INITIAL_CAPACITY = 256;
+
+struct Work_Deque {
+    std::atomic<s64>                top          = {};
+    u8                              padding_0[CACHE_LINE_SIZE - sizeof(std::atomic<s64>)];
+    std::atomic<s64>                bottom       = {};
+    std::atomic<Work_Deque_Buffer*> buffer       = {};
+    Allocator                       allocator    = {};
+};
+
+auto make_work_deque_buffer(Work_Deque* deque, s64 capacity) -> Work_Deque_Buffer* {
+    Work_Deque_Buffer* result = {};
+
+    push_allocator(deque->allocator,
+        result = (Work_Deque_Buffer*) alloc((s64)sizeof(Work_Deque_Buffer) + capacity * (s64)sizeof(std::atomic<Work_Entry*>));
+    )
+
+    new (result) Work_Deque_Buffer;
+    result->mask  = capacity - 1;
+    result->slots = (std::atomic<Work_Entry*>*)(result + 1);
+
+    return result;
+}
+
+void init_work_deque(Work_Deque* deque, s64 capacity = WORK_DEQUE_INITIAL_CAPACITY) {
+    auto& d = *deque;
+
+    remember_allocators(deque);
+
+    d.top.store(0, std::memory_order_relaxed);
+    d.bottom.store(0, std::memory_order_relaxed);
+    d.buffer.store(make_work_deque_buffer(deque, next_pow2(capacity)), std::memory_order_relaxed);
+}
+
+void deinit_work_deque(Work_Deque* deque) {
+    auto& d = *deque;
 
-        l.last   = entry;
-        l.count += 1;
+    auto buffer = d.buffer.load(std::memory_order_relaxed);
+    while (buffer) {
+        auto retired = buffer->retired;
+        push_allocator(d.allocator, dealloc(buffer, (s64) sizeof(Work_Deque_Buffer) + (buffer->mask + 1) * (s64) sizeof(std::atomic<Work_Entry*>));)
+        buffer = retired;
     }
 
-    signal(&l.semaphore);
+    d.buffer.store(nullptr, std::memory_order_relaxed);
 }
 
-auto get_work(Work_List* list) -> Work_Entry* {
-    auto& l = *list;
+auto grow_work_deque(Work_Deque* deque, Work_Deque_Buffer* old_buffer, s64 bottom, s64 top) -> Work_Deque_Buffer* {
+    auto& d = *deque;
+
+    auto new_buffer = make_work_deque_buffer(deque, (old_buffer->mask + 1) * 2);
+    for (auto i = top; i < bottom; ++i) {
+        new_buffer->slots[i & new_buffer->mask].store(old_buffer->slots[i & old_buffer->mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    new_buffer->retired = old_buffer;
+    d.buffer.store(new_buffer, std::memory_order_release);
 
-    lock(&l.mutex);
-    defer { unlock(&l.mutex); };
+    return new_buffer;
+}
+
+// Owner only:
+void deque_push(Work_Deque* deque, Work_Entry* entry) {
+    auto& d = *deque;
+
+    auto bottom = d.bottom.load(std::memory_order_relaxed);
+    auto top    = d.top.load(std::memory_order_acquire);
+    auto buffer = d.buffer.load(std::memory_order_relaxed);
+
+    if (bottom - top > buffer->mask) buffer = grow_work_deque(deque, buffer, bottom, top);
+
+    buffer->slots[bottom & buffer->mask].store(entry, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    d.bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+// Owner only:
+auto deque_pop(Work_Deque* deque) -> Work_Entry* {
+    auto& d = *deque;
+
+    auto bottom = d.bottom.load(std::memory_order_relaxed) - 1;
+    auto buffer = d.buffer.load(std::memory_order_relaxed);
+    d.bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top    = d.top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        d.bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    auto result = buffer->slots[bottom & buffer->mask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // Last entry, race any thieves for it:
+        if (!d.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            result = nullptr;
+        }
+        d.bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    return result;
+}
 
-    if (!l.first) return nullptr;
+// Any thread:
+auto deque_steal(Work_Deque* deque) -> Work_Entry* {
+    auto& d = *deque;
 
-    auto result = l.first;
+    auto top    = d.top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto bottom = d.bottom.load(std::memory_order_acquire);
 
-    l.first = result->next;
+    if (top >= bottom) return nullptr;
 
-    if (!l.first) l.last = nullptr;
+    auto buffer = d.buffer.load(std::memory_order_acquire);
+    auto result = buffer->slots[top & buffer->mask].load(std::memory_order_relaxed);
 
-    l.count -= 1;
+    // Lost the race to another thief or the owner:
+    if (!d.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
 
     return result;
 }
 
+auto deque_is_empty(Work_Deque* deque) -> bool {
+    auto& d = *deque;
+    return d.top.load(std::memory_order_acquire) >= d.bottom.load(std::memory_order_acquire);
+}
+
+// Instrumentation, filled in while Thread_Group.logging is on. Each counter has exactly one writer
+// (the worker, or the producer for the collection latency ones) so they are relaxed load/store pairs,
+// the atomics are only there so thread_group_get_stats() can read them while everything is running.
+struct Worker_Counters {
+    std::atomic<s64> jobs                     = {};
+    std::atomic<s64> tasks                    = {};
+    std::atomic<s64> steals                   = {};
+    std::atomic<s64> failed_steal_sweeps      = {};
+    std::atomic<s64> starvation_boosts        = {}; // times a lower priority got run ahead of a higher one
+
+    std::atomic<s64> queue_wait_ns            = {};
+    std::atomic<s64> queue_wait_max_ns        = {};
+    std::atomic<s64> execution_ns             = {};
+    std::atomic<s64> execution_max_ns         = {};
+    std::atomic<s64> idle_ns                  = {};
+
+    // Written by the producer in thread_group_get_completed_work():
+    std::atomic<s64> collected                = {};
+    std::atomic<s64> completed_latency_ns     = {};
+    std::atomic<s64> completed_latency_max_ns = {};
+};
+
+void bump_max(std::atomic<s64>* counter, s64 value) {
+    if (value > counter->load(std::memory_order_relaxed)) counter->store(value, std::memory_order_relaxed);
+}
+
+// Each Worker_Info gets whole pages of its own and is only ever first touched by its worker (see thread_group_run()),
+// so its deques, caches, counters and parker end up on the NUMA node that worker runs on.
+CONST_VAR s64 WORKER_INFO_PAGE_SIZE = 4096;
+
+struct Worker_Info {
+    // NOTE(WALKER): Must match the anonymous struct below for align_forward to work
+    struct Unpadded_Worker_Info {
+        Thread*           thread       = {};
+        Work_Deque        available[WORK_PRIORITY_COUNT];
+        Work_Inbox        incoming     = {};
+        Parker            parker       = {};
+        std::atomic<bool> sleeping     = {};
+        Work_Entry_Cache  entry_cache  = {};
+        Worker_Counters   counters     = {};
+
+        Thread_Group*     group        = {};
+        s64               worker_index = -1;
+        s64               numa_node    = {};
+        u64               steal_state  = {}; // xorshift state for picking steal victims
+        s64               passed_over[WORK_PRIORITY_COUNT] = {}; // picks that skipped queued work of that priority
+        bool              work_stealing = {};
+    };
+
+    union {
+        // struct {
+        //     Thread*           thread       = {};
+        //     Work_Deque        available[WORK_PRIORITY_COUNT];
+        //     Work_Inbox        incoming     = {};
+        //     Parker            parker       = {};
+        //     std::atomic<bool> sleeping     = {};
+        //     Work_Entry_Cache  entry_cache  = {};
+        //     Worker_Counters   counters     = {};
+
+        //     Thread_Group*     group        = {};
+        //     s64               worker_index = -1;
+        //     s64               numa_node    = {};
+        //     u64               steal_state  = {};
+        //     s64               passed_over[WORK_PRIORITY_COUNT];
+        //     bool              work_stealing = {};
+        // };
+        Unpadded_Worker_Info info               = {};
+        u8                   padding[align_forward(sizeof(Unpadded_Worker_Info), WORKER_INFO_PAGE_SIZE)];
+    };
+};
+
+// The part of a worker thread_group_init() sets up. These live in one array owned by the group and are only
+// touched when starting and shutting down, nothing on the hot path:
+struct Worker_Thread {
+    Thread thread    = {};
+    s64    numa_node = {}; // where get_worker_affinity() put it
+};
+
+// Set for threads that belong to a Thread_Group:
+thread_local Worker_Info* current_worker_info = {};
+
 // TODO(WALKER): Finish this
 
+// Where thread_group_init() puts its workers:
+enum class Thread_Placement {
+    NONE,                // let the OS schedule them anywhere
+    PIN_TO_CORES,        // one core per worker, filling up one node before moving to the next
+    PIN_TO_NODE,         // all workers float over the cores of a single node
+    SPREAD_ACROSS_NODES  // workers dealt round robin over the nodes, floating within their node
+};
+
 enum class Thread_Continue_Status {
     STOP,
     CONTINUE
@@ -106,137 +530,503 @@ using Thread_Group_Proc = auto(*)(Thread_Group* group, Thread* thread, void* wor
 
 struct Thread_Group {
     // User:
-    void*                   data                     = {};
-    Thread_Group_Proc       proc                     = {};
-    String                  name                     = {};
-    bool                    logging                  = true;
+    void*                     data                     = {};
+    Thread_Group_Proc         proc                     = {};
+    String                    name                     = {};
+    bool                      logging                  = true;
     using Time_Proc = auto(*)() -> f64;
-    Time_Proc               time_proc                = {};
+    Time_Proc                 time_proc                = {};
 
     // Internal:
-    Allocator               allocator                = {};
-    Array_View<Worker_Info> worker_info              = {};
-    void*                   worker_info_data_to_free = {};
-
-    s64                     next_worker_index        = {};
-    bool                    initted                  = {};
-    bool                    started                  = {};
-    bool                    should_exit              = {};
+    Allocator                 allocator                = {};
+    Array_View<Worker_Info>   worker_info              = {};
+    void*                     worker_info_data_to_free = {};
+    bool                      worker_info_mapped       = {}; // false if mmap failed and it came from the allocator instead
+    s64                       workers_allocated        = {}; // worker_info/worker_threads can end up shorter if thread creation failed
+    Array_View<Worker_Thread> worker_threads           = {};
+    bool                      work_stealing            = {};
+
+    // Nobody touches a Worker_Info before every worker has initialized its own:
+    std::atomic<s64>          workers_ready_count      = {};
+    Event                     workers_ready            = {};
+
+    std::atomic<s64>          sleeping_count           = {};
+
+    Work_Entry_Pool           entry_pool               = {};
+    Work_Entry_Cache          producer_cache           = {}; // for the (one) thread outside the group that adds/collects work
+
+    // Completion queue shared by all workers, collected by thread_group_get_completed_work():
+    Work_Inbox                completed                = {};
+    Event                     completed_event          = {};
+
+    s64                       next_worker_index        = {};
+    bool                      initted                  = {};
+    bool                      started                  = {};
+    std::atomic<bool>         should_exit              = {};
 };
 
-auto thread_group_run(Thread* thread) -> s64 {
-    auto& t = *thread;
+auto default_time_proc() -> f64 {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (f64) now.tv_sec + (f64) now.tv_nsec * 1e-9;
+}
 
-    auto& info  = t.worker_info->info;
+auto get_time(Thread_Group* group) -> f64 {
+    if (group->time_proc) return group->time_proc();
+    return default_time_proc();
+}
+
+auto to_nanoseconds(f64 seconds) -> s64 {
+    return (s64)(seconds * 1e9);
+}
+
+auto next_steal_random(Worker_Info::Unpadded_Worker_Info* info) -> u64 {
+    auto x = info->steal_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    info->steal_state = x;
+    return x;
+}
+
+// Visits every other worker once per priority (highest first), starting at a random victim so thieves don't all pile onto the same one.
+// Within a priority, workers on our own NUMA node are tried first, remote ones only if they have nothing.
+auto steal_work(Worker_Info* worker) -> Work_Entry* {
+    auto& info  = worker->info;
     auto& group = *info.group;
 
-    context.allocator = context.temp_allocator;
+    auto num_workers = group.worker_info.count;
+    if (num_workers <= 1) return nullptr;
 
-    Work_Entry* entry = {};
-    while (!group.should_exit) {
-        defer { reset_temp_allocator(); };
+    auto start = (s64)(next_steal_random(&info) % (u64)(num_workers - 1));
+    for (s64 priority = 0; priority < WORK_PRIORITY_COUNT; ++priority) {
+        for (s64 pass = 0; pass < 2; ++pass) {
+            for (s64 i = 0; i < num_workers - 1; ++i) {
+                auto  victim = (info.worker_index + 1 + (start + i) % (num_workers - 1)) % num_workers;
+                auto& other  = group.worker_info[victim].info;
+
+                bool same_node = other.numa_node == info.numa_node;
+                if (same_node != (pass == 0)) continue;
+
+                auto entry = deque_steal(&other.available[priority]);
+                if (entry) {
+                    if (group.logging) bump_counter(&info.counters.steals);
+                    return entry;
+                }
+            }
+        }
+    }
+
+    if (group.logging) bump_counter(&info.counters.failed_steal_sweeps);
+    return nullptr;
+}
+
+auto has_queued_work(Worker_Info* worker) -> bool {
+    for (auto& deque : worker->info.available) {
+        if (!deque_is_empty(&deque)) return true;
+    }
+    return false;
+}
+
+// Wakes one parked worker, if there are any. Returns the worker that was woken.
+auto wake_one_sleeper(Thread_Group* group, s64 start_index = 0) -> Worker_Info* {
+    auto& g = *group;
 
-        if (!entry) {
-            wait_for(&info.available.semaphore);
-            if (group.should_exit) break;
+    if (g.sleeping_count.load(std::memory_order_seq_cst) <= 0) return nullptr;
 
-            entry = get_work(&info.available);
+    auto num_workers = g.worker_info.count;
+    for (s64 i = 0; i < num_workers; ++i) {
+        auto& wi = g.worker_info[(start_index + i) % num_workers];
+        if (wi.info.sleeping.load(std::memory_order_seq_cst)) {
+            unpark(&wi.info.parker);
+            return &wi;
         }
+    }
+
+    return nullptr;
+}
+
+// Moves everything pushed from outside the group onto our own deque, where it can be stolen:
+auto drain_incoming(Worker_Info* worker) -> bool {
+    auto& info = worker->info;
+
+    auto entry = inbox_take_all(&info.incoming);
+    if (!entry) return false;
+
+    s64 count = {};
+    while (entry) {
+        auto next = entry->next;
+        entry->next = {};
+        deque_push(&info.available[(s64) entry->priority], entry);
+        entry = next;
+        count += 1;
+    }
+
+    // More than we can run right now, let a sleeping worker come steal some of it:
+    if (worker->info.work_stealing && count > 1) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake_one_sleeper(info.group, info.worker_index + 1);
+    }
+
+    return true;
+}
+
+// After this many picks that skip over queued lower priority work, that priority gets to run one entry:
+CONST_VAR s64 WORK_PRIORITY_STARVATION_LIMIT = 32;
+
+// Our own queues highest priority first, then steal (again highest priority first).
+auto find_work(Worker_Info* worker) -> Work_Entry* {
+    auto& info = worker->info;
+
+    drain_incoming(worker);
 
+    for (auto priority = WORK_PRIORITY_COUNT - 1; priority > 0; --priority) {
+        if (info.passed_over[priority] < WORK_PRIORITY_STARVATION_LIMIT) continue;
+
+        info.passed_over[priority] = 0;
+
+        auto entry = deque_pop(&info.available[priority]);
         if (entry) {
-            auto& e = *entry;
+            if (info.group->logging) bump_counter(&info.counters.starvation_boosts);
+            return entry;
+        }
+    }
 
-            e.thread_index = thread->index;
-            e.next         = {};
+    for (s64 priority = 0; priority < WORK_PRIORITY_COUNT; ++priority) {
+        auto entry = deque_pop(&info.available[priority]);
+        if (!entry) continue;
 
-            // logging here
+        for (auto lower = priority + 1; lower < WORK_PRIORITY_COUNT; ++lower) {
+            if (!deque_is_empty(&info.available[lower])) info.passed_over[lower] += 1;
+        }
+        return entry;
+    }
 
-            auto should_continue = Thread_Continue_Status::CONTINUE;
-            if (group.proc) {
-                should_continue = group.proc(&group, thread, e.work);
-            }
+    if (worker->info.work_stealing) return steal_work(worker);
+
+    return nullptr;
+}
+
+// Round robin, but hand work straight to a parked worker when there is one:
+auto pick_worker(Thread_Group* group) -> s64 {
+    auto& g = *group;
+
+    auto result = g.next_worker_index++;
+    if (g.next_worker_index >= g.worker_info.count) g.next_worker_index = 0;
+
+    if (g.sleeping_count.load(std::memory_order_relaxed) > 0) {
+        for (s64 i = 0; i < g.worker_info.count; ++i) {
+            auto index = (result + i) % g.worker_info.count;
+            if (g.worker_info[index].info.sleeping.load(std::memory_order_relaxed)) return index;
+        }
+    }
+
+    return result;
+}
+
+// Workers use their own cache, everyone else shares the producer cache (same single producer assumption as next_worker_index).
+auto get_entry_cache(Thread_Group* group) -> Work_Entry_Cache* {
+    auto worker = current_worker_info;
+    if (worker && worker->info.group == group) return &worker->info.entry_cache;
+    return &group->producer_cache;
+}
+
+// Pushes a task where it can be picked up: onto our own deque if we are a worker in this group
+// (waking a sleeper to come steal it), otherwise onto some worker's inbox.
+void push_task(Thread_Group* group, Work_Entry* entry) {
+    auto& g = *group;
+
+    if (entry->counter) task_counter_add(entry->counter, 1);
+    if (g.logging)      entry->issue_time = get_time(group);
+
+    auto worker = current_worker_info;
+    if (worker && worker->info.group == group) {
+        deque_push(&worker->info.available[(s64) entry->priority], entry);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake_one_sleeper(group, worker->info.worker_index + 1);
+        return;
+    }
+
+    auto thread_index = pick_worker(group);
+    entry->work_list_index = thread_index;
+
+    auto& info = g.worker_info[thread_index].info;
+    inbox_push(&info.incoming, entry, entry);
+    if (info.sleeping.load(std::memory_order_seq_cst)) unpark(&info.parker);
+}
+
+void run_task(Thread_Group* group, Work_Entry* entry) {
+    auto counter = entry->counter;
+
+    entry->task_proc(group, entry);
+    free_work_entry(&group->entry_pool, get_entry_cache(group), entry);
+
+    if (counter) task_counter_finish(counter);
+}
+
+// Anything this worker could pick up right now without sleeping:
+auto has_visible_work(Worker_Info* worker) -> bool {
+    auto& info  = worker->info;
+    auto& group = *info.group;
+
+    if (info.incoming.first.load(std::memory_order_seq_cst)) return true;
+    if (has_queued_work(worker)) return true;
+
+    if (worker->info.work_stealing) {
+        for (auto& wi : group.worker_info) {
+            if (has_queued_work(&wi)) return true;
+        }
+    }
+
+    return false;
+}
 
-            add_work(&info.completed, entry);
+CONST_VAR s64 THREAD_GROUP_SPIN_COUNT = 64;
 
-            if (should_continue == Thread_Continue_Status::STOP) break;
+// Idle protocol: spin for a bit, then advertise that we are sleeping and park.
+// NOTE(WALKER): The "sleeping" store followed by has_visible_work() pairs with the pusher's
+//               seq_cst push followed by the "sleeping" load, so at least one side sees the other
+//               and a wake can't get lost. Producers only pay for a futex wake when we are parked.
+auto wait_for_work(Worker_Info* worker) -> Work_Entry* {
+    auto& info  = worker->info;
+    auto& group = *info.group;
+
+    trace_scope("Thread_Group idle");
+
+    f64 idle_start = {};
+    if (group.logging) idle_start = get_time(&group);
+    defer { if (group.logging) bump_counter(&info.counters.idle_ns, to_nanoseconds(get_time(&group) - idle_start)); };
+
+    for (s64 i = 0; i < THREAD_GROUP_SPIN_COUNT; ++i) {
+        cpu_relax();
+        if (group.should_exit) return nullptr;
+
+        auto entry = find_work(worker);
+        if (entry) return entry;
+    }
+
+    info.sleeping.store(true, std::memory_order_seq_cst);
+    group.sleeping_count.fetch_add(1, std::memory_order_seq_cst);
+
+    if (!has_visible_work(worker) && !group.should_exit) park(&info.parker);
+
+    group.sleeping_count.fetch_sub(1, std::memory_order_seq_cst);
+    info.sleeping.store(false, std::memory_order_relaxed);
+
+    return nullptr;
+}
+
+// Runs one entry on a worker, either a task or a job for the group's proc:
+auto execute_work_entry(Worker_Info* worker, Work_Entry* entry) -> Thread_Continue_Status {
+    auto& info  = worker->info;
+    auto& group = *info.group;
+    auto& e     = *entry;
+
+    e.thread_index = info.thread->index;
+    e.executed_by  = info.worker_index;
+    e.next         = {};
+
+    auto logging = group.logging;
+
+    f64 start_time = {};
+    if (logging) {
+        start_time = get_time(&group);
+        if (e.issue_time >= 0) {
+            auto queue_wait = to_nanoseconds(start_time - e.issue_time);
+            bump_counter(&info.counters.queue_wait_ns, queue_wait);
+            bump_max(&info.counters.queue_wait_max_ns, queue_wait);
+        }
+    }
+
+    if (e.task_proc) {
+        trace_scope("Thread_Group task");
+
+        if (logging) bump_counter(&info.counters.tasks);
+        run_task(&group, entry); // entry is gone after this
+
+        if (logging) {
+            auto execution = to_nanoseconds(get_time(&group) - start_time);
+            bump_counter(&info.counters.execution_ns, execution);
+            bump_max(&info.counters.execution_max_ns, execution);
         }
+        return Thread_Continue_Status::CONTINUE;
+    }
+
+    auto should_continue = Thread_Continue_Status::CONTINUE;
+    if (group.proc) {
+        trace_scope("Thread_Group job");
+        should_continue = group.proc(&group, info.thread, e.work);
+    }
+
+    if (logging) {
+        bump_counter(&info.counters.jobs);
+
+        e.completion_time = get_time(&group);
+        auto execution    = to_nanoseconds(e.completion_time - start_time);
+        bump_counter(&info.counters.execution_ns, execution);
+        bump_max(&info.counters.execution_max_ns, execution);
+    }
+
+    // The producer can recycle the entry as soon as it's on the completed queue:
+    auto counter = e.counter;
+
+    inbox_push(&group.completed, entry, entry);
+    if (group.completed_event.state.load(std::memory_order_seq_cst) != EVENT_SET) set(&group.completed_event);
+
+    if (counter) task_counter_finish(counter);
+
+    return should_continue;
+}
 
-        // Do the work stealing thing:
-        if (t.worker_info->work_steal_indices.count) {
-            if (group.should_exit) break;
-
-            printf("work steal count = %ld\n", t.worker_info->work_steal_indices.count);
-
-            entry = get_work(&info.available);
-            if (entry) {
-                wait_for(&info.available.semaphore); // We still have work to do, don't bother stealing from someone else
-            } else {
-                for (auto i : t.worker_info->work_steal_indices) {
-                    entry = get_work(&group.worker_info[i].info.available);
-                    if (entry) {
-                        // logging here
-                        break;
-                    }
+auto thread_group_run(Thread* thread) -> s64 {
+    auto& t = *thread;
+
+    trace_scope("thread_group_run");
+
+    auto& group        = *(Thread_Group*) t.data;
+    auto  worker_index = t.worker_info - group.worker_info.data;
+
+    // Everything here is allocated (and so first touched) from the worker, which is already running on its own node:
+    // (context.temp is mapped lazily and only ever touched from here, so it ends up local as well)
+    memset((void*) t.worker_info, 0, sizeof(Worker_Info));
+
+    auto& info = t.worker_info->info;
+    info.thread        = thread;
+    info.group         = &group;
+    info.worker_index  = worker_index;
+    info.numa_node     = group.worker_threads[worker_index].numa_node;
+    info.steal_state   = ((u64)worker_index + 1) * 0x9E3779B97F4A7C15ULL;
+    info.work_stealing = group.work_stealing;
+
+    context.allocator   = context.temp_allocator;
+    current_worker_info = t.worker_info;
+
+    push_allocator(group.allocator,
+        for (auto& deque : info.available) init_work_deque(&deque);
+    )
+
+    if (group.workers_ready_count.fetch_add(1, std::memory_order_acq_rel) + 1 == group.worker_info.count) {
+        set(&group.workers_ready);
+    }
+    wait_for(&group.workers_ready);
+
+    while (!group.should_exit) {
+        auto entry = find_work(t.worker_info);
+        if (!entry) entry = wait_for_work(t.worker_info);
+        if (!entry) continue;
+
+        defer { reset_temp_allocator(); };
+
+        auto should_continue = execute_work_entry(t.worker_info, entry);
+        if (should_continue == Thread_Continue_Status::STOP) break;
+    }
+
+    return 0;
+}
+
+// Picks the CPUs a worker may run on, returns the NUMA node it ended up on.
+auto get_worker_affinity(Cpu_Topology* topology, Thread_Placement placement, s64 worker_index, s64 numa_node, cpu_set_t* affinity) -> s64 {
+    auto& nodes = topology->nodes;
+
+    CPU_ZERO(affinity);
+
+    switch (placement) {
+        case Thread_Placement::NONE: break;
+        case Thread_Placement::PIN_TO_CORES: {
+            auto cpu_index = worker_index % topology->cpu_count;
+            for (auto& node : nodes) {
+                if (cpu_index < node.cpus.count) {
+                    CPU_SET((size_t) node.cpus[cpu_index], affinity);
+                    return node.id;
                 }
+                cpu_index -= node.cpus.count;
             }
-        } else {
-            entry = {};
+        } break;
+        case Thread_Placement::PIN_TO_NODE: {
+            auto node = &nodes[0];
+            for (auto& n : nodes) {
+                if (n.id == numa_node) { node = &n; break; }
+            }
+            for (auto cpu : node->cpus) CPU_SET((size_t) cpu, affinity);
+            return node->id;
+        }
+        case Thread_Placement::SPREAD_ACROSS_NODES: {
+            auto& node = nodes[worker_index % nodes.count];
+            for (auto cpu : node.cpus) CPU_SET((size_t) cpu, affinity);
+            return node.id;
         }
     }
 
     return 0;
 }
 
-void thread_group_init(Thread_Group* group, s64 num_threads, Thread_Group_Proc group_proc, bool enable_work_stealing = false) {
+// "numa_node" is only used by Thread_Placement::PIN_TO_NODE (falls back to the first node if it doesn't exist).
+// Returns false if not every worker thread could be created. The group then only has the workers that were
+// (worker_info.count says how many), so it still works, just with fewer threads.
+auto thread_group_init(Thread_Group* group, s64 num_threads, Thread_Group_Proc group_proc, bool enable_work_stealing = false,
+                       Thread_Placement placement = Thread_Placement::NONE, s64 numa_node = 0) -> bool {
     auto& g = *group;
 
+    bool all_created = true;
+
     remember_allocators(group);
 
-push_allocator(g.allocator,
-    auto unaligned_worker_info = NewArray<Worker_Info>(num_threads + 1, false);
-    g.worker_info_data_to_free = (void*) unaligned_worker_info.data;
-    memset(g.worker_info_data_to_free, 0, sizeof(Worker_Info) * (num_threads + 1));
-    g.worker_info.data         = align_forward(unaligned_worker_info.data, CACHE_LINE_SIZE);
-    g.worker_info.count        = num_threads;
+    Cpu_Topology topology;
+    if (placement != Thread_Placement::NONE) topology = get_cpu_topology();
 
-    g.proc = group_proc;
+push_allocator(g.allocator,
+    // Mapped but not touched here, every worker zeroes and fills in its own (see thread_group_run()):
+    auto worker_info_size = (s64) sizeof(Worker_Info) * num_threads;
+    auto worker_info      = mmap(nullptr, (u64) worker_info_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-    s64 current_worker_index = {};
-    for (auto& wi : g.worker_info) {
-        auto& info = wi.info;
-        defer { ++current_worker_index; };
+    g.worker_info_mapped = worker_info != MAP_FAILED;
+    if (!g.worker_info_mapped) worker_info = NewArray<Worker_Info>(num_threads + 1, false).data; // not node local, but still works
 
-        thread_init(&info.thread, thread_group_run);
+    g.worker_info_data_to_free = worker_info;
+    g.worker_info.data         = align_forward((Worker_Info*) worker_info, CACHE_LINE_SIZE);
+    g.worker_info.count        = num_threads;
 
-        info.thread.worker_info = &wi;
+    g.worker_threads    = NewArray<Worker_Thread>(num_threads);
+    g.workers_allocated = num_threads;
+    g.work_stealing  = enable_work_stealing && (num_threads > 1);
 
-        init_work_list(&info.available);
-        init_work_list(&info.completed);
+    g.proc = group_proc;
 
-        info.group = group;
-        info.worker_index = current_worker_index;
+    init_work_entry_pool(&g.entry_pool);
 
-        // TODO(WALKER): Figure out a good work stealing algorithm.
-        //               For now, just loop to the right of yourself
-        //               until you get work
-        if (enable_work_stealing && (num_threads > 1)) {
-            auto indices = NewArray<s64>(num_threads - 1, false);
-            s64 cursor = (current_worker_index + 1) % num_threads;
-            for (s64 i = 0; i < num_threads - 1; ++i) {
-                indices[i] = cursor;
-                cursor = (cursor + 1) % num_threads;
-            }
+    for (s64 i = 0; i < num_threads; ++i) {
+        auto& wt = g.worker_threads[i];
 
-            wi.work_steal_indices = indices;
+        bool created = false;
+        if (placement != Thread_Placement::NONE) {
+            cpu_set_t affinity;
+            wt.numa_node = get_worker_affinity(&topology, placement, i, numa_node, &affinity);
+            created      = thread_init(&wt.thread, thread_group_run, &affinity);
+        }
+        if (!created) created = thread_init(&wt.thread, thread_group_run); // placement is best effort
+
+        // Workers wait on each other in thread_group_run(), so never count one that doesn't exist:
+        if (!created) {
+            g.worker_info.count    = i;
+            g.worker_threads.count = i;
+            all_created            = false;
+            break;
         }
+
+        wt.thread.data        = group;
+        wt.thread.worker_info = &g.worker_info[i];
     }
 
     g.initted = true;
 )
-}
 
+    return all_created;
+}
 void thread_group_start(Thread_Group* group) {
-    for (auto& wi : group->worker_info) thread_start(&wi.info.thread);
+    for (auto& wt : group->worker_threads) thread_start(&wt.thread);
+
+    // Work can only be handed out once every worker has set up its Worker_Info (only the ones that were created count):
+    if (group->worker_info.count) wait_for(&group->workers_ready);
     group->started = true;
 }
 
@@ -249,7 +1039,8 @@ auto thread_group_shutdown(Thread_Group* group, s32 timeout_milliseconds = -1) -
 
     bool all_done = true;
     if (g.started) {
-        for (auto& wi : g.worker_info) signal(&wi.info.available.semaphore);
+        g.should_exit = true;
+        for (auto& wi : g.worker_info) unpark(&wi.info.parker);
 
         std::chrono::time_point<std::chrono::steady_clock> start;
         if (timeout_milliseconds > 0) {
@@ -257,104 +1048,266 @@ auto thread_group_shutdown(Thread_Group* group, s32 timeout_milliseconds = -1) -
         }
 
         auto remaining_timeout_ms = timeout_milliseconds;
-        for (auto& wi : g.worker_info) {
-            auto& info = wi.info;
-
+        for (auto& wt : g.worker_threads) {
             if (remaining_timeout_ms > 0) {
                 auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
                 remaining_timeout_ms = (timeout_milliseconds - (s32) elapsed);
                 if (remaining_timeout_ms < 0) remaining_timeout_ms = 0;
             }
 
-            bool is_done = thread_is_done(&info.thread, remaining_timeout_ms);
+            bool is_done = thread_is_done(&wt.thread, remaining_timeout_ms);
             if (!is_done) all_done = false;
         }
     }
 
     if (!all_done) return false;
 
-    for (auto& wi : g.worker_info) {
-        auto& info = wi.info;
+    for (auto& wt : g.worker_threads) thread_deinit(&wt.thread);
 
-        thread_deinit(&info.thread);
-        deinit_work_list(&info.available);
-        deinit_work_list(&info.available);
-        push_allocator(g.allocator, dealloc(wi.work_steal_indices.data);)
+    // Workers only set up their deques once started:
+    if (g.started) {
+        for (auto& wi : g.worker_info) {
+            for (auto& deque : wi.info.available) deinit_work_deque(&deque);
+        }
     }
 
-    push_allocator(g.allocator, dealloc(g.worker_info_data_to_free);)
+    deinit_work_entry_pool(&g.entry_pool);
+
+    if (g.worker_info_mapped) {
+        munmap(g.worker_info_data_to_free, (u64)((s64) sizeof(Worker_Info) * g.workers_allocated));
+    } else {
+        push_allocator(g.allocator, dealloc(g.worker_info_data_to_free, (g.workers_allocated + 1) * (s64) sizeof(Worker_Info));)
+    }
+    push_allocator(g.allocator, dealloc(g.worker_threads.data, g.workers_allocated * (s64) sizeof(Worker_Thread));)
     return true;
 }
 
-void thread_group_add_work(Thread_Group* group, void* work) {
+// "counter", if given, is counted up here and back down once the work is on the completed queue.
+void thread_group_add_work(Thread_Group* group, void* work, Task_Counter* counter = nullptr, String logging_name = {},
+                           Work_Priority priority = Work_Priority::NORMAL) {
     auto& g = *group;
 
     // Assert(g.worker_info.count >= 0);
 
-push_allocator(g.allocator,
-    auto entry = New<Work_Entry>();
+    auto entry = alloc_work_entries(&g.entry_pool, get_entry_cache(group), 1);
     auto& e    = *entry;
 
-    e.work = work;
-    // e.logging_name = logging_name;
-    // e.issue_time = get_time(group);
+    if (counter) task_counter_add(counter, 1);
 
-    auto thread_index = g.next_worker_index++;
-    if (g.next_worker_index >= g.worker_info.count) g.next_worker_index = 0;
+    e.work         = work;
+    e.counter      = counter;
+    e.logging_name = logging_name;
+    e.priority     = priority;
+    if (g.logging) e.issue_time = get_time(group);
+
+    auto thread_index = pick_worker(group);
 
     e.work_list_index = thread_index;
 
-    auto list = &g.worker_info[thread_index].info.available;
-    add_work(list, entry);
+    auto& info = g.worker_info[thread_index].info;
+    inbox_push(&info.incoming, entry, entry);
+    if (info.sleeping.load(std::memory_order_seq_cst)) unpark(&info.parker);
+}
 
-    // do logging here
-)
+// Submits all of "work" at once: the entries come out of the pool in one go (a miss allocates them as a single slab),
+// and are split into one chunk per worker, where each chunk is spliced onto that worker's inbox with a single CAS and at most one wake.
+void thread_group_add_work_batch(Thread_Group* group, Array_View<void*> work, Task_Counter* counter = nullptr,
+                                 Work_Priority priority = Work_Priority::NORMAL) {
+    auto& g = *group;
+
+    if (work.count <= 0) return;
+
+    // Assert(g.worker_info.count >= 0);
+
+    auto entry = alloc_work_entries(&g.entry_pool, get_entry_cache(group), work.count);
+
+    if (counter) task_counter_add(counter, work.count);
+
+    f64 issue_time = -1.0;
+    if (g.logging) issue_time = get_time(group);
+
+    auto num_chunks = min(g.worker_info.count, work.count);
+    auto chunk_size = (work.count + num_chunks - 1) / num_chunks;
+
+    for (s64 first = 0; first < work.count; first += chunk_size) {
+        auto last = min(first + chunk_size, work.count) - 1;
+
+        auto thread_index = pick_worker(group);
+
+        auto chunk_first = entry;
+        auto chunk_last  = entry;
+        for (auto i = first; i <= last; ++i) {
+            auto& e = *entry;
+
+            e.work            = work[i];
+            e.work_list_index = thread_index;
+            e.counter         = counter;
+            e.priority        = priority;
+            e.issue_time      = issue_time;
+
+            chunk_last = entry;
+            entry      = e.next;
+        }
+        chunk_last->next = nullptr;
+
+        auto& info = g.worker_info[thread_index].info;
+        inbox_push(&info.incoming, chunk_first, chunk_last);
+        if (info.sleeping.load(std::memory_order_seq_cst)) unpark(&info.parker);
+    }
 }
 
-auto thread_group_get_completed_work(Thread_Group* group) -> Array_View<void*> /* uses temp_allocator */ {
+auto thread_group_get_pool_stats(Thread_Group* group) -> Work_Entry_Pool_Stats {
+    auto& g = *group;
+
+    Work_Entry_Pool_Stats result;
+
+    auto add_cache = [&](Work_Entry_Cache* cache) {
+        result.cache_hits  += cache->cache_hits.load(std::memory_order_relaxed);
+        result.shared_hits += cache->shared_hits.load(std::memory_order_relaxed);
+        result.misses      += cache->misses.load(std::memory_order_relaxed);
+    };
+
+    add_cache(&g.producer_cache);
+    for (auto& wi : g.worker_info) add_cache(&wi.info.entry_cache);
+
+    lock(&g.entry_pool.mutex);
+    defer { unlock(&g.entry_pool.mutex); };
+
+    result.slab_count     = g.entry_pool.slab_count;
+    result.shared_entries = g.entry_pool.count;
+    for (auto slab = g.entry_pool.slabs; slab; slab = slab->next) result.slab_entries += slab->count;
+
+    return result;
+}
+
+// Collects everything on the group's completion queue with a single exchange (no per-worker sweep),
+// in the order it completed. With a timeout it blocks until something completes (-1 waits forever),
+// see also wait_for(Task_Counter*) for waiting on a specific set of work.
+auto thread_group_get_completed_work(Thread_Group* group, s32 timeout_milliseconds = 0) -> Array_View<void*> /* uses temp_allocator */ {
     auto& g = *group;
 
     Resizable_Array<void*> results;
     results.allocator = context.temp_allocator;
 
-    for (auto& wi : g.worker_info) {
-        auto& info = wi.info;
+    auto completed = inbox_take_all(&g.completed);
 
-        auto& list = info.completed;
+    if (!completed && timeout_milliseconds != 0) {
+        s64 deadline = {};
+        if (timeout_milliseconds > 0) deadline = get_monotonic_milliseconds() + timeout_milliseconds;
 
-        s64         count     = {};
-        Work_Entry* completed = {};
+        while (!completed) {
+            // Reset before re-checking, so a completion racing with us leaves the event set:
+            reset(&g.completed_event);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
 
-        {
-            lock(&list.mutex);
-            defer { unlock(&list.mutex); };
+            completed = inbox_take_all(&g.completed);
+            if (completed) break;
 
-            count     = list.count;
-            completed = list.first;
+            s32 remaining = -1;
+            if (timeout_milliseconds > 0) {
+                remaining = (s32) max(deadline - get_monotonic_milliseconds(), (s64) 0);
+                if (!remaining) break;
+            }
 
-            if (list.first) {
-                list.first = {};
-                list.last  = {};
-                list.count = {};
+            if (wait_for(&g.completed_event, remaining) != Wait_For_Result::SUCCESS) {
+                completed = inbox_take_all(&g.completed);
+                break;
             }
+
+            completed = inbox_take_all(&g.completed);
         }
+    }
+
+    // The queue is a stack, flip it back into completion order:
+    Work_Entry* reversed = {};
+    s64         count    = {};
+    while (completed) {
+        auto next       = completed->next;
+        completed->next = reversed;
+        reversed        = completed;
+        completed       = next;
+        count          += 1;
+    }
 
-        if (!completed) continue;
+    if (!reversed) return results;
 
-        array_reserve(&results, results.count + count); // @speed: make this better?
+    array_reserve(&results, count);
 
-        while(completed) {
-            array_add(&results, completed->work);
-            auto next = completed->next;
+    f64 collect_time = {};
+    if (g.logging) collect_time = get_time(group);
 
-            // do logging here
+    while (reversed) {
+        auto& e = *reversed;
 
-            push_allocator(g.allocator, dealloc(completed);)
-            completed = next;
+        array_add(&results, e.work);
+        auto next = e.next;
+
+        if (g.logging && e.completion_time >= 0 && e.executed_by >= 0) {
+            auto& counters = g.worker_info[e.executed_by].info.counters;
+            auto  latency  = to_nanoseconds(collect_time - e.completion_time);
+            bump_counter(&counters.collected);
+            bump_counter(&counters.completed_latency_ns, latency);
+            bump_max(&counters.completed_latency_max_ns, latency);
         }
+
+        free_work_entry(&g.entry_pool, get_entry_cache(group), reversed);
+        reversed = next;
     }
 
-    // do logging here
+    return results;
+}
+
+// Snapshot of the per-worker counters (totals since thread_group_init), one per worker.
+// Diff two snapshots to get numbers for a frame. Times are in seconds.
+struct Worker_Stats {
+    s64 worker_index              = {};
+
+    s64 jobs                      = {};
+    s64 tasks                     = {};
+    s64 steals                    = {};
+    s64 failed_steal_sweeps       = {};
+    s64 starvation_boosts         = {};
+
+    f64 queue_wait                = {};
+    f64 queue_wait_max            = {};
+    f64 execution                 = {};
+    f64 execution_max             = {};
+    f64 idle                      = {};
+
+    s64 collected                 = {};
+    f64 completed_latency         = {};
+    f64 completed_latency_max     = {};
+};
+
+auto thread_group_get_stats(Thread_Group* group) -> Array_View<Worker_Stats> /* uses temp_allocator */ {
+    auto& g = *group;
+
+    Array_View<Worker_Stats> results;
+    push_allocator(context.temp_allocator,
+        results = NewArray<Worker_Stats>(g.worker_info.count);
+    )
+
+    auto seconds = [](std::atomic<s64>& counter) -> f64 { return (f64) counter.load(std::memory_order_relaxed) * 1e-9; };
+
+    for (s64 i = 0; i < results.count; ++i) {
+        auto& c = g.worker_info[i].info.counters;
+        auto& r = results[i];
+
+        r.worker_index          = i;
+        r.jobs                  = c.jobs.load(std::memory_order_relaxed);
+        r.tasks                 = c.tasks.load(std::memory_order_relaxed);
+        r.steals                = c.steals.load(std::memory_order_relaxed);
+        r.failed_steal_sweeps   = c.failed_steal_sweeps.load(std::memory_order_relaxed);
+        r.starvation_boosts     = c.starvation_boosts.load(std::memory_order_relaxed);
+        r.queue_wait            = seconds(c.queue_wait_ns);
+        r.queue_wait_max        = seconds(c.queue_wait_max_ns);
+        r.execution             = seconds(c.execution_ns);
+        r.execution_max         = seconds(c.execution_max_ns);
+        r.idle                  = seconds(c.idle_ns);
+        r.collected             = c.collected.load(std::memory_order_relaxed);
+        r.completed_latency     = seconds(c.completed_latency_ns);
+        r.completed_latency_max = seconds(c.completed_latency_max_ns);
+    }
 
     return results;
 }
@@ -0,0 +1,83 @@
+// CPU / NUMA topology (Linux), read from /sys/devices/system/node. Only CPUs this process is allowed
+// to run on are reported. Machines without NUMA info show up as a single node holding every CPU.
+
+#include <cstdio>
+
+struct Numa_Node {
+    s64                  id   = {};
+    Resizable_Array<s64> cpus = {};
+};
+
+struct Cpu_Topology {
+    Resizable_Array<Numa_Node> nodes     = {};
+    s64                        cpu_count = {};
+};
+
+// Parses a sysfs cpu list like "0-3,8,10-11":
+void parse_cpu_list(const char* text, cpu_set_t* allowed, Resizable_Array<s64>* cpus) {
+    auto p = text;
+    while (*p) {
+        if (*p < '0' || *p > '9') { ++p; continue; }
+
+        s64 first = {};
+        while (*p >= '0' && *p <= '9') first = first * 10 + (*p++ - '0');
+
+        auto last = first;
+        if (*p == '-') {
+            ++p;
+            last = 0;
+            while (*p >= '0' && *p <= '9') last = last * 10 + (*p++ - '0');
+        }
+
+        for (auto cpu = first; cpu <= last; ++cpu) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET((size_t) cpu, allowed)) array_add(cpus, cpu);
+        }
+    }
+}
+
+auto get_cpu_topology() -> Cpu_Topology /* uses temp_allocator */ {
+    Cpu_Topology result;
+    result.nodes.allocator = context.temp_allocator;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (s64 cpu = 0; cpu < CPU_SETSIZE; ++cpu) CPU_SET((size_t) cpu, &allowed);
+    }
+
+    // NOTE(WALKER): Node ids can have holes, so just probe a reasonable range:
+    for (s64 id = 0; id < 64; ++id) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%ld/cpulist", id);
+
+        auto file = fopen(path, "r");
+        if (!file) continue;
+        defer { fclose(file); };
+
+        char text[4096] = {};
+        if (!fgets(text, sizeof(text), file)) continue;
+
+        Numa_Node node;
+        node.id             = id;
+        node.cpus.allocator = context.temp_allocator;
+        parse_cpu_list(text, &allowed, &node.cpus);
+
+        if (node.cpus.count) {
+            result.cpu_count += node.cpus.count;
+            array_add(&result.nodes, node);
+        }
+    }
+
+    if (!result.nodes.count) {
+        Numa_Node node;
+        node.cpus.allocator = context.temp_allocator;
+        for (s64 cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET((size_t) cpu, &allowed)) array_add(&node.cpus, cpu);
+        }
+
+        result.cpu_count = node.cpus.count;
+        array_add(&result.nodes, node);
+    }
+
+    return result;
+}
@@ -5,7 +5,14 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 // module specific:
 #include "Primitives.hpp"
+#include "Channel.hpp"
+#include "Topology.hpp"
 #include "Thread_Group.hpp"
+#include "Tasks.hpp"
+#include "Task_Graph.hpp"
@@ -0,0 +1,221 @@
+#pragma once
+
+// Tracking_Allocator: wraps another allocator and keeps count of what goes through it, push it around any
+// subsystem to see what that subsystem allocates:
+//     Tracking_Allocator tracker;
+//     init(&tracker);                                  // wraps context.allocator
+//     push_allocator(tracking_allocator(&tracker), ...)
+//     print_tracking_report(&tracker);
+//
+// It keeps live/peak bytes, counts by size bucket and, with track_sites, the same per allocation site.
+// A site is whatever name the innermost allocation_site("...") scope on that thread gave, so tag the
+// interesting spots and everything under them gets attributed there:
+//     allocation_site("parse_file");
+//
+// Every allocation carries a small header (its size and site) so frees find their way back to the right
+// counters, that plus a handful of relaxed atomic adds is the whole overhead without track_sites.
+// NOTE(WALKER): Safe to push on several threads at once, the site table sits behind a spin lock though,
+//               so track_sites is for finding things, not something to leave on in hot multithreaded code.
+
+#include <cstdio>
+#include <sched.h>
+
+#include "Basic/module.hpp"
+#include "Hash_Table.hpp"
+
+CONST_VAR s64 TRACKING_HEADER_SIZE  = 16; // keeps the 16 byte alignment of whatever we wrap
+CONST_VAR s64 TRACKING_SIZE_BUCKETS = 24; // <= 1, <= 2, <= 4 ... <= 4MB, the last one takes everything bigger
+
+struct Tracking_Header {
+    s64         size = {};
+    const char* site = {};
+};
+
+static_assert(sizeof(Tracking_Header) <= TRACKING_HEADER_SIZE, "Tracking_Header doesn't fit");
+
+struct Allocation_Site_Stats {
+    s64 allocations      = {};
+    s64 live_allocations = {};
+    s64 live_bytes       = {};
+    s64 peak_bytes       = {};
+    s64 total_bytes      = {};
+};
+
+struct Tracking_Allocator {
+    Allocator        parent           = {};
+    bool             track_sites      = {};
+
+    std::atomic<s64> live_bytes       = {};
+    std::atomic<s64> peak_bytes       = {};
+    std::atomic<s64> allocations      = {};
+    std::atomic<s64> reallocations    = {};
+    std::atomic<s64> deallocations    = {};
+    std::atomic<s64> total_bytes      = {};
+    std::atomic<s64> size_buckets[TRACKING_SIZE_BUCKETS];
+
+    std::atomic_flag sites_lock       = ATOMIC_FLAG_INIT;
+    Hash_Table<const char*, Allocation_Site_Stats> sites = {};
+};
+
+// Innermost allocation_site() of this thread:
+thread_local const char* current_allocation_site = {};
+
+#define allocation_site(name)                                                  \
+    auto GEN_DEFER_NAME(_outer_site_, __LINE__) = current_allocation_site;     \
+    current_allocation_site = name;                                            \
+    defer { current_allocation_site = GEN_DEFER_NAME(_outer_site_, __LINE__); }
+
+// "parent" is where the memory really comes from, context.allocator when not given.
+void init(Tracking_Allocator* tracker, bool track_sites = false, Allocator parent = {}) {
+    auto& t = *tracker;
+
+    t.parent      = parent.proc ? parent : context.allocator;
+    t.track_sites = track_sites;
+
+    for (auto& bucket : t.size_buckets) bucket.store(0, std::memory_order_relaxed);
+
+    // The table's own memory shouldn't show up in (or come from) what we are tracking:
+    if (track_sites) {
+        push_allocator(Allocator(&default_allocator_proc, nullptr), table_init(&t.sites);)
+    }
+}
+
+void deinit(Tracking_Allocator* tracker) {
+    auto& t = *tracker;
+
+    if (t.track_sites) table_deinit(&t.sites);
+    t.sites = {};
+}
+
+auto tracking_size_bucket(s64 size) -> s64 {
+    if (size <= 1) return 0;
+    return min((s64)(64 - __builtin_clzll((u64)(size - 1))), TRACKING_SIZE_BUCKETS - 1);
+}
+
+// Adds "size" bytes (negative when freeing) and "count" allocations to the site's stats:
+void update_allocation_site(Tracking_Allocator* tracker, const char* site, s64 size, s64 count, s64 new_allocations) {
+    auto& t = *tracker;
+
+    while (t.sites_lock.test_and_set(std::memory_order_acquire)) sched_yield();
+    defer { t.sites_lock.clear(std::memory_order_release); };
+
+    auto stats = table_find_pointer(&t.sites, site);
+    if (!stats) stats = table_add(&t.sites, site, Allocation_Site_Stats{});
+
+    stats->allocations      += new_allocations;
+    stats->live_allocations += count;
+    stats->live_bytes       += size;
+    stats->peak_bytes        = max(stats->peak_bytes, stats->live_bytes);
+    if (size > 0) stats->total_bytes += size;
+}
+
+void add_tracked_bytes(Tracking_Allocator* tracker, s64 size) {
+    auto& t = *tracker;
+
+    auto live = t.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    auto peak = t.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !t.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+    if (size > 0) t.total_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+// The header has the real sizes, so the old_size we get passed isn't needed:
+auto tracking_allocator_proc(Allocator_Mode mode, s64 requested_size, s64, void* old_memory, void* allocator_data) -> void* {
+    auto tracker = (Tracking_Allocator*) allocator_data;
+    auto& t      = *tracker;
+    auto& p      = t.parent;
+
+    Tracking_Header* old_header = {};
+    if (old_memory) old_header = (Tracking_Header*)((u8*) old_memory - TRACKING_HEADER_SIZE);
+
+    switch(mode) {
+        case ALLOCATE:   {
+            auto memory = (u8*) p.proc(ALLOCATE, requested_size + TRACKING_HEADER_SIZE, 0, nullptr, p.data);
+            if (!memory) return nullptr;
+
+            auto header  = (Tracking_Header*) memory;
+            header->size = requested_size;
+            header->site = current_allocation_site;
+
+            t.allocations.fetch_add(1, std::memory_order_relaxed);
+            t.size_buckets[tracking_size_bucket(requested_size)].fetch_add(1, std::memory_order_relaxed);
+            add_tracked_bytes(tracker, requested_size);
+            if (t.track_sites) update_allocation_site(tracker, header->site, requested_size, 1, 1);
+
+            return memory + TRACKING_HEADER_SIZE;
+        }
+        case REALLOCATE: {
+            if (!old_memory) return tracking_allocator_proc(ALLOCATE, requested_size, 0, nullptr, allocator_data);
+
+            auto old_tracked_size = old_header->size;
+            auto site             = old_header->site;
+
+            auto memory = (u8*) p.proc(REALLOCATE, requested_size + TRACKING_HEADER_SIZE, old_tracked_size + TRACKING_HEADER_SIZE, old_header, p.data);
+            if (!memory) return nullptr;
+
+            auto header  = (Tracking_Header*) memory;
+            header->size = requested_size;
+            header->site = site;
+
+            t.reallocations.fetch_add(1, std::memory_order_relaxed);
+            t.size_buckets[tracking_size_bucket(requested_size)].fetch_add(1, std::memory_order_relaxed);
+            add_tracked_bytes(tracker, requested_size - old_tracked_size);
+            if (t.track_sites) update_allocation_site(tracker, site, requested_size - old_tracked_size, 0, 0);
+
+            return memory + TRACKING_HEADER_SIZE;
+        }
+        case DEALLOCATE: {
+            if (!old_memory) break;
+
+            auto size = old_header->size;
+            auto site = old_header->site;
+
+            t.deallocations.fetch_add(1, std::memory_order_relaxed);
+            add_tracked_bytes(tracker, -size);
+            if (t.track_sites) update_allocation_site(tracker, site, -size, -1, 0);
+
+            p.proc(DEALLOCATE, 0, size + TRACKING_HEADER_SIZE, old_header, p.data);
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+auto tracking_allocator(Tracking_Allocator* tracker) -> Allocator {
+    return Allocator{&tracking_allocator_proc, tracker};
+}
+
+// Whatever is still live is either in use or leaked, the sites say which is which:
+void print_tracking_report(Tracking_Allocator* tracker, FILE* file = stdout) {
+    auto& t = *tracker;
+
+    fprintf(file, "%ld allocations, %ld reallocations, %ld deallocations, %ld bytes total\n",
+            t.allocations.load(), t.reallocations.load(), t.deallocations.load(), t.total_bytes.load());
+    fprintf(file, "live: %ld bytes in %ld allocations, peak: %ld bytes\n",
+            t.live_bytes.load(), t.allocations.load() - t.deallocations.load(), t.peak_bytes.load());
+
+    fprintf(file, "by size:");
+    for (s64 i = 0; i < TRACKING_SIZE_BUCKETS; ++i) {
+        auto count = t.size_buckets[i].load();
+        if (!count) continue;
+
+        if (i < TRACKING_SIZE_BUCKETS - 1) fprintf(file, " <=%lld: %ld", 1LL << i, count);
+        else                               fprintf(file, " >%lld: %ld",  1LL << (i - 1), count);
+    }
+    fprintf(file, "\n");
+
+    if (!t.track_sites) return;
+
+    while (t.sites_lock.test_and_set(std::memory_order_acquire)) sched_yield();
+    defer { t.sites_lock.clear(std::memory_order_release); };
+
+    fprintf(file, "%24s %12s %12s %14s %14s %14s\n", "site", "allocs", "live allocs", "live bytes", "peak bytes", "total bytes");
+    for (auto& entry : t.sites.entries) {
+        if (entry.hash < FIRST_VALID_HASH) continue;
+
+        auto& s = entry.value;
+        fprintf(file, "%24s %12ld %12ld %14ld %14ld %14ld\n", entry.key ? entry.key : "(untagged)",
+                s.allocations, s.live_allocations, s.live_bytes, s.peak_bytes, s.total_bytes);
+    }
+}